@@ -0,0 +1,311 @@
+/**
+ * @file AsymmetricKey.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "AsymmetricKey.h"
+
+#ifdef TL_JWT_USE_OPENSSL
+
+#include <openssl/bio.h>
+#include <openssl/core_names.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "detail/ThreadCache.h"
+#include "sha2.h"
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+EVP_PKEY* readPem(string_view pem, bool isPrivate)
+{
+    auto* bio = BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size()));
+    if (!bio)
+    {
+        return nullptr;
+    }
+    auto* key = isPrivate
+                    ? PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr)
+                    : PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    return key;
+}
+
+bool isType(EVP_PKEY* key, AsymmetricKey::Type type)
+{
+    if (type == AsymmetricKey::Ed25519)
+    {
+        return EVP_PKEY_is_a(key, "ED25519");
+    }
+    char group[64];
+    size_t len;
+    return EVP_PKEY_is_a(key, "EC") &&
+           EVP_PKEY_get_utf8_string_param(
+               key, OSSL_PKEY_PARAM_GROUP_NAME, group, sizeof(group), &len) &&
+           string_view(group, len) == "prime256v1";
+}
+
+struct FreePkeyContext
+{
+    void operator()(EVP_PKEY_CTX* ctx) const
+    {
+        EVP_PKEY_CTX_free(ctx);
+    }
+};
+
+using PkeyContext = unique_ptr<EVP_PKEY_CTX, FreePkeyContext>;
+
+struct FreeMdContext
+{
+    void operator()(EVP_MD_CTX* ctx) const
+    {
+        EVP_MD_CTX_free(ctx);
+    }
+};
+
+using MdContext = unique_ptr<EVP_MD_CTX, FreeMdContext>;
+
+/// The contexts of a key on a thread, which are initialized on first use.
+/// The Ed25519 ones are prototypes, which are copied by every call.
+struct ThreadContexts
+{
+    PkeyContext sign;
+    PkeyContext verify;
+    MdContext signMd;
+    MdContext verifyMd;
+};
+
+/// A copy of the prototype in the context of this thread. EVP_DigestSign()
+/// and EVP_DigestVerify() finalize the context, so every call works on a copy.
+EVP_MD_CTX* copyOf(EVP_MD_CTX* prototype)
+{
+    thread_local MdContext scratch(EVP_MD_CTX_new());
+    if (!scratch || !EVP_MD_CTX_copy_ex(scratch.get(), prototype))
+    {
+        throw runtime_error("EVP_MD_CTX_copy_ex failed");
+    }
+    return scratch.get();
+}
+
+void sha256(string_view message, unsigned char* digest)
+{
+    sha2::Sha256 ctx;
+    ctx.update(message.data(), message.size());
+    ctx.final(digest);
+}
+}  // namespace
+
+AsymmetricKey::AsymmetricKey(Type type,
+                             string_view privateKeyPem,
+                             string_view publicKeyPem)
+    : type_(type)
+{
+    if (!privateKeyPem.empty())
+    {
+        privateKey_ = readPem(privateKeyPem, true);
+        if (!privateKey_ || !isType(privateKey_, type))
+        {
+            EVP_PKEY_free(privateKey_);
+            throw invalid_argument("Invalid private key");
+        }
+    }
+    if (!publicKeyPem.empty())
+    {
+        publicKey_ = readPem(publicKeyPem, false);
+        if (!publicKey_ || !isType(publicKey_, type))
+        {
+            EVP_PKEY_free(publicKey_);
+            EVP_PKEY_free(privateKey_);
+            throw invalid_argument("Invalid public key");
+        }
+    }
+    else if (privateKey_)
+    {
+        // the private key contains the public key
+        EVP_PKEY_up_ref(privateKey_);
+        publicKey_ = privateKey_;
+    }
+    else
+    {
+        throw invalid_argument("No key is provided");
+    }
+}
+
+AsymmetricKey::~AsymmetricKey()
+{
+    EVP_PKEY_free(privateKey_);
+    EVP_PKEY_free(publicKey_);
+}
+
+EVP_PKEY_CTX* AsymmetricKey::threadContext(bool forSigning) const
+{
+    auto& contexts = detail::ThreadCache<ThreadContexts>::get(
+        owner_, []() { return ThreadContexts{}; });
+    auto& ctx = forSigning ? contexts.sign : contexts.verify;
+    if (ctx)
+    {
+        return ctx.get();
+    }
+
+    ctx.reset(EVP_PKEY_CTX_new_from_pkey(
+        nullptr, forSigning ? privateKey_ : publicKey_, nullptr));
+    if (!ctx || (forSigning ? EVP_PKEY_sign_init(ctx.get())
+                            : EVP_PKEY_verify_init(ctx.get())) <= 0)
+    {
+        ctx.reset();
+        throw runtime_error("EVP_PKEY_CTX initialization failed");
+    }
+    return ctx.get();
+}
+
+EVP_MD_CTX* AsymmetricKey::threadMdPrototype(bool forSigning) const
+{
+    auto& contexts = detail::ThreadCache<ThreadContexts>::get(
+        owner_, []() { return ThreadContexts{}; });
+    auto& prototype = forSigning ? contexts.signMd : contexts.verifyMd;
+    if (!prototype)
+    {
+        MdContext ctx(EVP_MD_CTX_new());
+        int ret = 0;
+        if (ctx && forSigning)
+        {
+            ret = EVP_DigestSignInit(
+                ctx.get(), nullptr, nullptr, nullptr, privateKey_);
+        }
+        else if (ctx)
+        {
+            ret = EVP_DigestVerifyInit(
+                ctx.get(), nullptr, nullptr, nullptr, publicKey_);
+        }
+        if (ret <= 0)
+        {
+            throw runtime_error("EVP_MD_CTX initialization failed");
+        }
+        prototype = std::move(ctx);
+    }
+
+    return prototype.get();
+}
+
+void AsymmetricKey::sign(string_view message, unsigned char* out) const
+{
+    if (!privateKey_)
+    {
+        throw runtime_error("No private key to sign");
+    }
+
+    if (type_ == Ed25519)
+    {
+        auto* ctx = copyOf(threadMdPrototype(true));
+        size_t len = signatureSize;
+        if (EVP_DigestSign(ctx,
+                           out,
+                           &len,
+                           reinterpret_cast<const unsigned char*>(
+                               message.data()),
+                           message.size()) <= 0)
+        {
+            throw runtime_error("Ed25519 signing failed");
+        }
+        return;
+    }
+
+    unsigned char digest[sha2::Sha256::digestSize];
+    sha256(message, digest);
+    unsigned char der[128];
+    size_t derLength = sizeof(der);
+    if (EVP_PKEY_sign(threadContext(true),
+                      der,
+                      &derLength,
+                      digest,
+                      sizeof(digest)) <= 0)
+    {
+        throw runtime_error("ES256 signing failed");
+    }
+    // DER to r || s
+    const unsigned char* p = der;
+    auto* sig = d2i_ECDSA_SIG(nullptr, &p, static_cast<long>(derLength));
+    if (!sig)
+    {
+        throw runtime_error("ES256 signing failed");
+    }
+    const BIGNUM *r, *s;
+    ECDSA_SIG_get0(sig, &r, &s);
+    BN_bn2binpad(r, out, 32);
+    BN_bn2binpad(s, out + 32, 32);
+    ECDSA_SIG_free(sig);
+}
+
+bool AsymmetricKey::verify(string_view message, string_view signature) const
+{
+    return Verifier(*this).verify(message, signature);
+}
+
+AsymmetricKey::Verifier::Verifier(const AsymmetricKey& key)
+{
+    if (key.type_ == Ed25519)
+    {
+        prototype_ = key.threadMdPrototype(false);
+    }
+    else
+    {
+        context_ = key.threadContext(false);
+    }
+}
+
+bool AsymmetricKey::Verifier::verify(string_view message,
+                                     string_view signature) const
+{
+    if (signature.size() != signatureSize)
+    {
+        return false;
+    }
+    auto* sigBytes = reinterpret_cast<const unsigned char*>(signature.data());
+
+    if (prototype_)
+    {
+        return EVP_DigestVerify(copyOf(prototype_),
+                                sigBytes,
+                                signature.size(),
+                                reinterpret_cast<const unsigned char*>(
+                                    message.data()),
+                                message.size()) == 1;
+    }
+
+    // r || s to DER
+    auto* sig = ECDSA_SIG_new();
+    auto* r = BN_bin2bn(sigBytes, 32, nullptr);
+    auto* s = BN_bin2bn(sigBytes + 32, 32, nullptr);
+    if (!sig || !r || !s || !ECDSA_SIG_set0(sig, r, s))
+    {
+        BN_free(r);
+        BN_free(s);
+        ECDSA_SIG_free(sig);
+        return false;
+    }
+    unsigned char der[128];
+    unsigned char* p = der;
+    auto derLength = i2d_ECDSA_SIG(sig, &p);
+    ECDSA_SIG_free(sig);
+    if (derLength <= 0)
+    {
+        return false;
+    }
+
+    unsigned char digest[sha2::Sha256::digestSize];
+    sha256(message, digest);
+    return EVP_PKEY_verify(context_,
+                           der,
+                           derLength,
+                           digest,
+                           sizeof(digest)) == 1;
+}
+
+#endif
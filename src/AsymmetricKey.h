@@ -0,0 +1,111 @@
+/**
+ * @file AsymmetricKey.h
+ * @brief Ed25519 and ECDSA P-256 keys over OpenSSL, for the EdDSA and ES256
+ * algorithms. It is only compiled when TL_JWT_USE_OPENSSL is defined.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#ifdef TL_JWT_USE_OPENSSL
+
+#include <openssl/evp.h>
+#include <string_view>
+#include "detail/ThreadCache.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief A key pair which is parsed once. Both of the keys are PEM encoded,
+ * and either of them can be empty: a verifying service only needs the public
+ * key, and the public key is derived from the private key if it is empty.
+ *
+ * The ES256 signatures are in the JWS format, which is r || s (RFC 7518
+ * §3.4), not DER.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class AsymmetricKey
+{
+  public:
+    /// Whether the key is Ed25519 (EdDSA), otherwise P-256 (ES256).
+    enum Type
+    {
+        Ed25519,
+        P256,
+    };
+
+    /**
+     * @throw std::invalid_argument If the keys can not be parsed, or they are
+     * not of the type.
+     */
+    AsymmetricKey(Type type,
+                  std::string_view privateKeyPem,
+                  std::string_view publicKeyPem);
+
+    AsymmetricKey(const AsymmetricKey&) = delete;
+    AsymmetricKey& operator=(const AsymmetricKey&) = delete;
+    ~AsymmetricKey();
+
+    /// The size of the signature of both Ed25519 and ES256.
+    static constexpr size_t signatureSize = 64;
+
+    bool canSign() const
+    {
+        return privateKey_ != nullptr;
+    }
+
+    /**
+     * @brief Sign the message, write signatureSize bytes to out.
+     *
+     * @throw std::runtime_error If there is no private key.
+     */
+    void sign(std::string_view message, unsigned char* out) const;
+
+    /// Verify the raw signature of the message.
+    bool verify(std::string_view message, std::string_view signature) const;
+
+    /**
+     * @brief Verifies by the contexts of the current thread, which are found
+     * once, e.g. for a batch of tokens. It is only used on the thread which
+     * creates it, while the key is alive.
+     */
+    class Verifier
+    {
+      public:
+        explicit Verifier(const AsymmetricKey& key);
+
+        /// The same as AsymmetricKey::verify().
+        bool verify(std::string_view message,
+                    std::string_view signature) const;
+
+      private:
+        /// ES256
+        EVP_PKEY_CTX* context_{nullptr};
+        /// Ed25519
+        EVP_MD_CTX* prototype_{nullptr};
+    };
+
+  private:
+    /// The EVP_PKEY_CTX of the current thread, which is initialized once for
+    /// signing or verifying ES256 digests.
+    EVP_PKEY_CTX* threadContext(bool forSigning) const;
+
+    /// The Ed25519 EVP_MD_CTX of the current thread, which is initialized
+    /// once for the key, and copied by every call.
+    EVP_MD_CTX* threadMdPrototype(bool forSigning) const;
+
+    Type type_;
+    EVP_PKEY* privateKey_{nullptr};
+    EVP_PKEY* publicKey_{nullptr};
+    /// Owns the contexts of the threads.
+    detail::CacheOwner owner_;
+};
+
+}  // namespace tl::jwt
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @file Base64Url.h
+ * @brief base64url (RFC 4648 §5) without padding, which reads from and
+ * writes to caller provided buffers.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tl::jwt::base64url
+{
+
+constexpr size_t encodedLength(size_t len)
+{
+    return (len * 4 + 2) / 3;
+}
+
+/// The upper bound of the decoded length.
+constexpr size_t decodedLength(size_t len)
+{
+    return len * 3 / 4;
+}
+
+/**
+ * @brief Write encodedLength(len) chars to out.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+inline void encode(const void* data, size_t len, char* out)
+{
+    static constexpr char table[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    auto* in = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3)
+    {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *out++ = table[v >> 18];
+        *out++ = table[(v >> 12) & 0x3f];
+        *out++ = table[(v >> 6) & 0x3f];
+        *out++ = table[v & 0x3f];
+    }
+    if (len - i == 1)
+    {
+        uint32_t v = in[i] << 16;
+        *out++ = table[v >> 18];
+        *out++ = table[(v >> 12) & 0x3f];
+    }
+    else if (len - i == 2)
+    {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8);
+        *out++ = table[v >> 18];
+        *out++ = table[(v >> 12) & 0x3f];
+        *out++ = table[(v >> 6) & 0x3f];
+    }
+}
+
+/**
+ * @brief Decode `in` into out, which has at least decodedLength(in.size())
+ * bytes. The standard alphabet and the trailing paddings are accepted too.
+ *
+ * @return The decoded length, or -1 if `in` is not valid base64.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+inline ptrdiff_t decode(std::string_view in, void* out)
+{
+    static constexpr auto table = [] {
+        struct
+        {
+            signed char values[256];
+        } t{};
+        for (auto& v : t.values)
+        {
+            v = -1;
+        }
+        for (int i = 0; i < 26; ++i)
+        {
+            t.values['A' + i] = static_cast<signed char>(i);
+            t.values['a' + i] = static_cast<signed char>(26 + i);
+        }
+        for (int i = 0; i < 10; ++i)
+        {
+            t.values['0' + i] = static_cast<signed char>(52 + i);
+        }
+        t.values['-'] = t.values['+'] = 62;
+        t.values['_'] = t.values['/'] = 63;
+        return t;
+    }();
+
+    while (!in.empty() && in.back() == '=')
+    {
+        in.remove_suffix(1);
+    }
+    if (in.size() % 4 == 1)
+    {
+        return -1;
+    }
+    auto* begin = static_cast<unsigned char*>(out);
+    auto* p = begin;
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (auto c : in)
+    {
+        auto v = table.values[static_cast<unsigned char>(c)];
+        if (v < 0)
+        {
+            return -1;
+        }
+        buffer = (buffer << 6) | v;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            *p++ = static_cast<unsigned char>(buffer >> bits);
+        }
+    }
+    return p - begin;
+}
+
+}  // namespace tl::jwt::base64url
@@ -0,0 +1,355 @@
+/**
+ * @file Cbor.h
+ * @brief A minimal CBOR (RFC 8949) writer and reader, used by the CWT
+ * (RFC 8392) tokens. Only the definite length items are supported.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace tl::jwt::cbor
+{
+
+/// The major types of CBOR.
+enum MajorType : uint8_t
+{
+    UnsignedInt = 0,
+    NegativeInt = 1,
+    ByteString = 2,
+    TextString = 3,
+    Array = 4,
+    Map = 5,
+    Tag = 6,
+    Simple = 7,
+};
+
+constexpr uint8_t False = 0xf4;
+constexpr uint8_t True = 0xf5;
+constexpr uint8_t Null = 0xf6;
+constexpr uint8_t Float64 = 0xfb;
+
+/**
+ * @brief Write the head of an item, which is the major type and the argument
+ * in the shortest form.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename String>
+void writeHead(String& out, MajorType type, uint64_t value)
+{
+    auto major = static_cast<uint8_t>(type << 5);
+    if (value < 24)
+    {
+        out += static_cast<char>(major | value);
+        return;
+    }
+    int bytes;
+    if (value <= 0xff)
+    {
+        out += static_cast<char>(major | 24);
+        bytes = 1;
+    }
+    else if (value <= 0xffff)
+    {
+        out += static_cast<char>(major | 25);
+        bytes = 2;
+    }
+    else if (value <= 0xffffffff)
+    {
+        out += static_cast<char>(major | 26);
+        bytes = 4;
+    }
+    else
+    {
+        out += static_cast<char>(major | 27);
+        bytes = 8;
+    }
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        out += static_cast<char>(value >> (i * 8));
+    }
+}
+
+template <typename String>
+void writeInt(String& out, int64_t value)
+{
+    if (value >= 0)
+    {
+        writeHead(out, UnsignedInt, static_cast<uint64_t>(value));
+    }
+    else
+    {
+        // -1 - n, without overflow for INT64_MIN
+        writeHead(out, NegativeInt, ~static_cast<uint64_t>(value));
+    }
+}
+
+template <typename String>
+void writeText(String& out, std::string_view text)
+{
+    writeHead(out, TextString, text.size());
+    out.append(text.data(), text.size());
+}
+
+template <typename String>
+void writeBytes(String& out, std::string_view bytes)
+{
+    writeHead(out, ByteString, bytes.size());
+    out.append(bytes.data(), bytes.size());
+}
+
+template <typename String>
+void writeDouble(String& out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out += static_cast<char>(Float64);
+    for (int i = 7; i >= 0; --i)
+    {
+        out += static_cast<char>(bits >> (i * 8));
+    }
+}
+
+/**
+ * @brief Reads CBOR items one by one from a buffer. Every read method returns
+ * false on malformed or truncated input.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class Reader
+{
+  public:
+    explicit Reader(std::string_view data)
+        : cur_(reinterpret_cast<const uint8_t*>(data.data())),
+          end_(cur_ + data.size())
+    {
+    }
+
+    bool atEnd() const
+    {
+        return cur_ == end_;
+    }
+
+    /// The major type of the next item, or -1 at the end.
+    int peekType() const
+    {
+        return cur_ == end_ ? -1 : (*cur_ >> 5);
+    }
+
+    /// The first byte of the next item, or -1 at the end.
+    int peekByte() const
+    {
+        return cur_ == end_ ? -1 : *cur_;
+    }
+
+    /**
+     * @brief Read the head of an item. The simple values and the floating
+     * points (major type 7) are not read by this method.
+     */
+    bool readHead(MajorType& type, uint64_t& value)
+    {
+        if (cur_ == end_ || (*cur_ >> 5) == Simple)
+        {
+            return false;
+        }
+        type = static_cast<MajorType>(*cur_ >> 5);
+        return readArgument(value);
+    }
+
+    /// Read the head of an item, which must be of the expected type.
+    bool expect(MajorType type, uint64_t& value)
+    {
+        MajorType actual;
+        return readHead(actual, value) && actual == type;
+    }
+
+    /// Read a byte string or a text string without copying it.
+    bool readString(MajorType type, std::string_view& out)
+    {
+        uint64_t length;
+        if (!expect(type, length) ||
+            length > static_cast<uint64_t>(end_ - cur_))
+        {
+            return false;
+        }
+        out = std::string_view(reinterpret_cast<const char*>(cur_), length);
+        cur_ += length;
+        return true;
+    }
+
+    /// Read a simple value, e.g. True, False or Null.
+    bool readSimple(uint8_t& value)
+    {
+        if (cur_ == end_ || *cur_ < 0xe0 || *cur_ > 0xf7)
+        {
+            return false;
+        }
+        value = *cur_++;
+        return true;
+    }
+
+    /// Read a half, single or double precision float.
+    bool readFloat(double& value)
+    {
+        if (cur_ == end_)
+        {
+            return false;
+        }
+        int bytes;
+        switch (*cur_)
+        {
+            case 0xf9:
+                bytes = 2;
+                break;
+            case 0xfa:
+                bytes = 4;
+                break;
+            case Float64:
+                bytes = 8;
+                break;
+            default:
+                return false;
+        }
+        if (end_ - cur_ < bytes + 1)
+        {
+            return false;
+        }
+        ++cur_;
+        uint64_t bits = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            bits = (bits << 8) | *cur_++;
+        }
+        if (bytes == 8)
+        {
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+        else if (bytes == 4)
+        {
+            auto bits32 = static_cast<uint32_t>(bits);
+            float f;
+            std::memcpy(&f, &bits32, sizeof(f));
+            value = f;
+        }
+        else
+        {
+            // RFC 8949 Appendix D
+            auto exp = (bits >> 10) & 0x1f;
+            auto mant = bits & 0x3ff;
+            if (exp == 0)
+            {
+                value = std::ldexp(static_cast<double>(mant), -24);
+            }
+            else if (exp != 31)
+            {
+                value = std::ldexp(static_cast<double>(mant + 1024),
+                                   static_cast<int>(exp) - 25);
+            }
+            else
+            {
+                value = mant == 0 ? INFINITY : NAN;
+            }
+            if (bits & 0x8000)
+            {
+                value = -value;
+            }
+        }
+        return true;
+    }
+
+    /// Skip a whole item, including the nested arrays and maps.
+    bool skip(int depth = 0)
+    {
+        if (depth > maxDepth || cur_ == end_)
+        {
+            return false;
+        }
+        if ((*cur_ >> 5) == Simple)
+        {
+            double d;
+            uint8_t s;
+            return readFloat(d) || readSimple(s);
+        }
+        MajorType type;
+        uint64_t value;
+        if (!readHead(type, value))
+        {
+            return false;
+        }
+        switch (type)
+        {
+            case ByteString:
+            case TextString:
+                if (value > static_cast<uint64_t>(end_ - cur_))
+                {
+                    return false;
+                }
+                cur_ += value;
+                return true;
+            case Array:
+            case Map:
+            {
+                auto items = type == Map ? value * 2 : value;
+                if (items > static_cast<uint64_t>(end_ - cur_))
+                {
+                    return false;
+                }
+                for (uint64_t i = 0; i < items; ++i)
+                {
+                    if (!skip(depth + 1))
+                    {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case Tag:
+                return skip(depth + 1);
+            default:
+                return true;
+        }
+    }
+
+    static constexpr int maxDepth = 64;
+
+  private:
+    bool readArgument(uint64_t& value)
+    {
+        auto info = *cur_++ & 0x1f;
+        if (info < 24)
+        {
+            value = info;
+            return true;
+        }
+        if (info > 27)
+        {
+            // indefinite lengths and reserved values
+            return false;
+        }
+        auto bytes = 1 << (info - 24);
+        if (end_ - cur_ < bytes)
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value = (value << 8) | *cur_++;
+        }
+        return true;
+    }
+
+    const uint8_t* cur_;
+    const uint8_t* end_;
+};
+
+}  // namespace tl::jwt::cbor
@@ -0,0 +1,410 @@
+/**
+ * @file ClaimPolicy.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "ClaimPolicy.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+/// The bits of the first n items.
+uint64_t maskOf(size_t n)
+{
+    return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+}  // namespace
+
+ClaimPolicy::ClaimPolicy(const Json::Value& config)
+{
+    if (!config.isObject())
+    {
+        throw invalid_argument("The policy must be an object");
+    }
+    auto toValue = [](const Json::Value& json) {
+        Value value;
+        if (json.isString())
+        {
+            value.type = Value::String;
+            value.str = json.asString();
+        }
+        else if (json.isBool())
+        {
+            value.type = Value::Bool;
+            value.boolean = json.asBool();
+        }
+        else if (json.isNumeric())
+        {
+            value.type = Value::Number;
+            value.number = json.asDouble();
+        }
+        else
+        {
+            throw invalid_argument(
+                "The policy values must be strings, numbers or booleans");
+        }
+        return value;
+    };
+    auto toValues = [&toValue](const Json::Value& json) {
+        vector<Value> values;
+        if (!json.isArray())
+        {
+            values.push_back(toValue(json));
+            return values;
+        }
+        for (const auto& item : json)
+        {
+            values.push_back(toValue(item));
+        }
+        return values;
+    };
+
+    for (auto it = config.begin(); it != config.end(); ++it)
+    {
+        auto name = it.name();
+        const auto& item = *it;
+        if (name == "required")
+        {
+            if (!item.isArray())
+            {
+                throw invalid_argument("policy.required must be an array");
+            }
+            for (const auto& claim : item)
+            {
+                if (!claim.isString())
+                {
+                    throw invalid_argument(
+                        "policy.required must be an array of strings");
+                }
+                ruleOf(claim.asString());
+            }
+        }
+        else if (name == "audience")
+        {
+            auto& rule = ruleOf("aud");
+            rule.oneOf = toValues(item);
+            rule.error = InvalidAudience;
+        }
+        else if (name == "equals" || name == "contains" || name == "range")
+        {
+            if (!item.isObject())
+            {
+                throw invalid_argument("policy." + name +
+                                       " must be an object");
+            }
+            for (auto claim = item.begin(); claim != item.end(); ++claim)
+            {
+                auto& rule = ruleOf(claim.name());
+                if (name == "equals")
+                {
+                    rule.equals = toValue(*claim);
+                }
+                else if (name == "contains")
+                {
+                    rule.contains = toValues(*claim);
+                    if (rule.contains.size() > 64)
+                    {
+                        throw invalid_argument(
+                            "policy.contains has too many values");
+                    }
+                }
+                else
+                {
+                    if (!claim->isObject())
+                    {
+                        throw invalid_argument(
+                            "policy.range." + claim.name() +
+                            " must be an object of \"min\" and \"max\"");
+                    }
+                    const auto& min = (*claim)["min"];
+                    const auto& max = (*claim)["max"];
+                    if ((!min.isNull() && !min.isNumeric()) ||
+                        (!max.isNull() && !max.isNumeric()))
+                    {
+                        throw invalid_argument(
+                            "policy.range must be numbers");
+                    }
+                    if (!min.isNull())
+                    {
+                        rule.min = min.asDouble();
+                    }
+                    if (!max.isNull())
+                    {
+                        rule.max = max.asDouble();
+                    }
+                }
+            }
+        }
+        else
+        {
+            throw invalid_argument("Unknown policy: " + name);
+        }
+    }
+    if (rules_.size() > maxClaims)
+    {
+        throw invalid_argument("The policy has too many claims");
+    }
+}
+
+ClaimPolicy::Rule& ClaimPolicy::ruleOf(const string& claim)
+{
+    auto it = lower_bound(rules_.begin(),
+                          rules_.end(),
+                          claim,
+                          [](const Rule& rule, const string& claim) {
+                              return rule.claim < claim;
+                          });
+    if (it == rules_.end() || it->claim != claim)
+    {
+        it = rules_.insert(it, Rule{});
+        it->claim = claim;
+    }
+    return *it;
+}
+
+int ClaimPolicy::find(string_view claim) const
+{
+    auto it = lower_bound(rules_.begin(),
+                          rules_.end(),
+                          claim,
+                          [](const Rule& rule, string_view claim) {
+                              return rule.claim < claim;
+                          });
+    if (it == rules_.end() || it->claim != claim)
+    {
+        return -1;
+    }
+    return static_cast<int>(it - rules_.begin());
+}
+
+bool ClaimPolicy::Value::matches(json::Scanner scanner) const
+{
+    switch (type)
+    {
+        case String:
+        {
+            string value;
+            return scanner.readString(value) && value == str;
+        }
+        case Number:
+        {
+            double value;
+            return scanner.readDouble(value) && value == number;
+        }
+        case Bool:
+        {
+            bool value;
+            return scanner.readBool(value) && value == boolean;
+        }
+    }
+    return false;
+}
+
+bool ClaimPolicy::Value::matches(const Json::Value& value) const
+{
+    switch (type)
+    {
+        case String:
+            return value.isString() && value.asString() == str;
+        case Number:
+            return value.isNumeric() && !value.isBool() &&
+                   value.asDouble() == number;
+        case Bool:
+            return value.isBool() && value.asBool() == boolean;
+    }
+    return false;
+}
+
+bool ClaimPolicy::Rule::matches(json::Scanner scanner) const
+{
+    if (equals && !equals->matches(scanner))
+    {
+        return false;
+    }
+    if (!oneOf.empty())
+    {
+        auto isAccepted = [this](const json::Scanner& value) {
+            return any_of(oneOf.begin(), oneOf.end(), [&value](auto& v) {
+                return v.matches(value);
+            });
+        };
+        bool accepted = false;
+        if (scanner.peek('['))
+        {
+            auto copy = scanner;
+            auto ok = copy.forEachElement([&](json::Scanner& element) {
+                accepted = accepted || isAccepted(element);
+                return element.skipValue();
+            });
+            accepted = accepted && ok;
+        }
+        else
+        {
+            accepted = isAccepted(scanner);
+        }
+        if (!accepted)
+        {
+            return false;
+        }
+    }
+    if (!contains.empty())
+    {
+        if (!scanner.peek('['))
+        {
+            return false;
+        }
+        uint64_t found = 0;
+        auto copy = scanner;
+        auto ok = copy.forEachElement([&](json::Scanner& element) {
+            for (size_t i = 0; i < contains.size(); ++i)
+            {
+                if (contains[i].matches(element))
+                {
+                    found |= uint64_t(1) << i;
+                }
+            }
+            return element.skipValue();
+        });
+        if (!ok || found != maskOf(contains.size()))
+        {
+            return false;
+        }
+    }
+    if (min || max)
+    {
+        double value;
+        if (!scanner.readDouble(value) || (min && value < *min) ||
+            (max && value > *max))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ClaimPolicy::Rule::matches(const Json::Value& value) const
+{
+    if (equals && !equals->matches(value))
+    {
+        return false;
+    }
+    auto isAccepted = [this](const Json::Value& item) {
+        return any_of(oneOf.begin(), oneOf.end(), [&item](auto& v) {
+            return v.matches(item);
+        });
+    };
+    if (!oneOf.empty())
+    {
+        bool accepted = false;
+        if (value.isArray())
+        {
+            for (const auto& item : value)
+            {
+                accepted = accepted || isAccepted(item);
+            }
+        }
+        else
+        {
+            accepted = isAccepted(value);
+        }
+        if (!accepted)
+        {
+            return false;
+        }
+    }
+    if (!contains.empty())
+    {
+        if (!value.isArray())
+        {
+            return false;
+        }
+        for (const auto& expected : contains)
+        {
+            if (none_of(value.begin(), value.end(), [&expected](auto& item) {
+                    return expected.matches(item);
+                }))
+            {
+                return false;
+            }
+        }
+    }
+    if (min || max)
+    {
+        if (!value.isNumeric() || value.isBool() ||
+            (min && value.asDouble() < *min) ||
+            (max && value.asDouble() > *max))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ClaimPolicy::Matcher::onMember(string_view key,
+                                    const json::Scanner& value)
+{
+    auto index = policy_.find(key);
+    if (index < 0)
+    {
+        return;
+    }
+    seen_ |= uint64_t(1) << index;
+    const auto& rule = policy_.rules_[index];
+    if (error_ == Ok && !rule.matches(value))
+    {
+        error_ = rule.error;
+    }
+}
+
+Result ClaimPolicy::Matcher::finish() const
+{
+    if (error_ != Ok)
+    {
+        return error_;
+    }
+    return seen_ == maskOf(policy_.rules_.size()) ? Ok : MissingClaim;
+}
+
+Result ClaimPolicy::check(string_view payload) const
+{
+    json::Scanner scanner(payload);
+    auto matcher = this->matcher();
+    auto ok = scanner.forEachMember([&matcher](auto key, json::Scanner& s) {
+        matcher.onMember(key, s);
+        return s.skipValue();
+    });
+    if (!ok || !scanner.atEnd())
+    {
+        return InvalidPayload;
+    }
+    return matcher.finish();
+}
+
+Result ClaimPolicy::check(const Json::Value& payload) const
+{
+    if (!payload.isObject())
+    {
+        return InvalidPayload;
+    }
+    auto result = Ok;
+    for (const auto& rule : rules_)
+    {
+        const auto* value = payload.find(rule.claim.data(),
+                                         rule.claim.data() + rule.claim.size());
+        if (!value)
+        {
+            result = MissingClaim;
+        }
+        else if (!rule.matches(*value))
+        {
+            return rule.error;
+        }
+    }
+    return result;
+}
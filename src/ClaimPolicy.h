@@ -0,0 +1,147 @@
+/**
+ * @file ClaimPolicy.h
+ * @brief The constraints on the claims of decoded tokens, which are compiled
+ * once from the config and checked in one pass over the payload.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <json/value.h>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "JsonScanner.h"
+#include "Result.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief A compiled claim policy. The config is an object of:
+ *
+ * - "required": the names of the claims which must be present.
+ * - "equals": the claims which must be equal to the strings, numbers or
+ *   booleans.
+ * - "audience": the accepted audiences, "aud" must be one of them, or an
+ *   array which contains one of them.
+ * - "contains": the array claims which must contain all of the values.
+ * - "range": the numeric claims which must be in {"min": a, "max": b}, both
+ *   bounds are optional and inclusive.
+ *
+ * Every constrained claim is required as well. A missing claim results in
+ * MissingClaim, a mismatched "aud" in InvalidAudience, the others in
+ * InvalidClaim.
+ *
+ * @code
+ * "policy": {
+ *     "required": ["sub"],
+ *     "equals": {"iss": "tanglong3bf"},
+ *     "audience": ["visitor", "admin"],
+ *     "contains": {"roles": ["reader"]},
+ *     "range": {"level": {"min": 1, "max": 10}}
+ * }
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class ClaimPolicy
+{
+  public:
+    /**
+     * @throw std::invalid_argument If the config is malformed.
+     */
+    explicit ClaimPolicy(const Json::Value& config);
+
+    /**
+     * @brief The state of checking a payload, whose members are fed one by
+     * one, e.g. by the same scan which reads the other claims.
+     */
+    class Matcher
+    {
+      public:
+        explicit Matcher(const ClaimPolicy& policy) : policy_(policy)
+        {
+        }
+
+        /// Check a member, the scanner is positioned before the value and is
+        /// not moved.
+        void onMember(std::string_view key, const json::Scanner& value);
+
+        /// The Result of the whole payload, after all members are fed.
+        Result finish() const;
+
+        /// Forget the members, to check another payload.
+        void reset()
+        {
+            seen_ = 0;
+            error_ = Ok;
+        }
+
+      private:
+        const ClaimPolicy& policy_;
+        uint64_t seen_{0};
+        Result error_{Ok};
+    };
+
+    Matcher matcher() const
+    {
+        return Matcher(*this);
+    }
+
+    /// Check a JSON payload in one pass.
+    Result check(std::string_view payload) const;
+
+    /// Check a payload which is already decoded, e.g. from a CWT.
+    Result check(const Json::Value& payload) const;
+
+    /// The most claims of a policy.
+    static constexpr size_t maxClaims = 64;
+
+  private:
+    struct Value
+    {
+        enum Type
+        {
+            String,
+            Number,
+            Bool,
+        } type;
+        std::string str;
+        double number{0};
+        bool boolean{false};
+
+        bool matches(json::Scanner scanner) const;
+        bool matches(const Json::Value& value) const;
+    };
+
+    /// All constraints of a claim.
+    struct Rule
+    {
+        std::string claim;
+        std::optional<Value> equals;
+        /// The accepted values of a string or an array, e.g. "aud".
+        std::vector<Value> oneOf;
+        std::vector<Value> contains;
+        std::optional<double> min;
+        std::optional<double> max;
+        Result error{InvalidClaim};
+
+        bool matches(json::Scanner scanner) const;
+        bool matches(const Json::Value& value) const;
+    };
+
+    Rule& ruleOf(const std::string& claim);
+    /// The index of the rule of the claim, or -1.
+    int find(std::string_view claim) const;
+
+    /// Sorted by the claim names.
+    std::vector<Rule> rules_;
+};
+
+}  // namespace tl::jwt
@@ -0,0 +1,342 @@
+/**
+ * @file Claims.h
+ * @brief Compile-time mapping between the claims of a jwt payload and the
+ * fields of a user defined struct.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "JsonScanner.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief Binds a claim name to a member of T.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename T, typename M>
+struct Field
+{
+    std::string_view name;
+    M T::*member;
+};
+
+/**
+ * @brief Declare a claim of a struct, which is used by JwtUtil::encode<T>()
+ * and JwtUtil::decode<T>().
+ *
+ * @code
+ * struct UserClaims
+ * {
+ *     int64_t uid{0};
+ *     std::string role;
+ *     std::optional<std::vector<std::string>> scopes;
+ *
+ *     static constexpr auto jwtFields =
+ *         std::make_tuple(tl::jwt::field("uid", &UserClaims::uid),
+ *                         tl::jwt::field("role", &UserClaims::role),
+ *                         tl::jwt::field("scopes", &UserClaims::scopes));
+ * };
+ * @endcode
+ *
+ * Supported member types are bool, integers, floating points, std::string,
+ * and std::optional / std::vector of them. An empty std::optional is not
+ * written to the payload.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename T, typename M>
+constexpr Field<T, M> field(std::string_view name, M T::*member)
+{
+    return {name, member};
+}
+
+/**
+ * @brief The types which declare their claims by a static `jwtFields` tuple.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename T>
+concept ClaimsStruct = requires { std::tuple_size<decltype(T::jwtFields)>::value; };
+
+/**
+ * @brief Reads and writes a value of type M. Specialize it to support more
+ * types.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename M, typename = void>
+struct ClaimTraits;
+
+template <>
+struct ClaimTraits<bool>
+{
+    static bool read(json::Scanner& scanner, bool& value)
+    {
+        return scanner.readBool(value);
+    }
+
+    template <typename String>
+    static void write(String& out, bool value)
+    {
+        out += value ? "true" : "false";
+    }
+};
+
+template <typename M>
+struct ClaimTraits<
+    M,
+    std::enable_if_t<std::is_integral_v<M> && !std::is_same_v<M, bool>>>
+{
+    static bool read(json::Scanner& scanner, M& value)
+    {
+        int64_t v;
+        if (!scanner.readInt64(v))
+        {
+            return false;
+        }
+        if constexpr (std::is_unsigned_v<M>)
+        {
+            if (v < 0 || static_cast<uint64_t>(v) >
+                             std::numeric_limits<M>::max())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (v < std::numeric_limits<M>::min() ||
+                v > std::numeric_limits<M>::max())
+            {
+                return false;
+            }
+        }
+        value = static_cast<M>(v);
+        return true;
+    }
+
+    template <typename String>
+    static void write(String& out, M value)
+    {
+        if constexpr (std::is_unsigned_v<M>)
+        {
+            json::writeUInt(out, value);
+        }
+        else
+        {
+            json::writeInt(out, value);
+        }
+    }
+};
+
+template <typename M>
+struct ClaimTraits<M, std::enable_if_t<std::is_floating_point_v<M>>>
+{
+    static bool read(json::Scanner& scanner, M& value)
+    {
+        double v;
+        if (!scanner.readDouble(v))
+        {
+            return false;
+        }
+        value = static_cast<M>(v);
+        return true;
+    }
+
+    template <typename String>
+    static void write(String& out, M value)
+    {
+        json::writeDouble(out, value);
+    }
+};
+
+template <>
+struct ClaimTraits<std::string>
+{
+    static bool read(json::Scanner& scanner, std::string& value)
+    {
+        return scanner.readString(value);
+    }
+
+    template <typename String>
+    static void write(String& out, const std::string& value)
+    {
+        json::writeString(out, value);
+    }
+};
+
+template <typename M>
+struct ClaimTraits<std::optional<M>>
+{
+    static bool read(json::Scanner& scanner, std::optional<M>& value)
+    {
+        if (scanner.peek('n'))
+        {
+            value.reset();
+            return scanner.readNull();
+        }
+        return ClaimTraits<M>::read(scanner, value.emplace());
+    }
+
+    template <typename String>
+    static void write(String& out, const std::optional<M>& value)
+    {
+        if (value)
+        {
+            ClaimTraits<M>::write(out, *value);
+        }
+        else
+        {
+            out += "null";
+        }
+    }
+
+    static bool present(const std::optional<M>& value)
+    {
+        return value.has_value();
+    }
+};
+
+template <typename M>
+struct ClaimTraits<std::vector<M>>
+{
+    static bool read(json::Scanner& scanner, std::vector<M>& value)
+    {
+        value.clear();
+        return scanner.forEachElement([&value](json::Scanner& s) {
+            return ClaimTraits<M>::read(s, value.emplace_back());
+        });
+    }
+
+    template <typename String>
+    static void write(String& out, const std::vector<M>& value)
+    {
+        out += '[';
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            if (i != 0)
+            {
+                out += ',';
+            }
+            ClaimTraits<M>::write(out, value[i]);
+        }
+        out += ']';
+    }
+};
+
+namespace detail
+{
+template <typename Traits, typename M, typename = void>
+struct HasPresent : std::false_type
+{
+};
+
+template <typename Traits, typename M>
+struct HasPresent<
+    Traits,
+    M,
+    std::void_t<decltype(Traits::present(std::declval<const M&>()))>>
+    : std::true_type
+{
+};
+
+/// Whether the value should be written to the payload.
+template <typename M>
+bool isPresent(const M& value)
+{
+    if constexpr (HasPresent<ClaimTraits<M>, M>::value)
+    {
+        return ClaimTraits<M>::present(value);
+    }
+    else
+    {
+        return true;
+    }
+}
+
+/**
+ * @brief Find the field of T named `name` and read the value into it.
+ *
+ * @return false if the value does not match the type of the field.
+ *   `matched` is set to true if there is such a field.
+ */
+template <typename T>
+bool readField(json::Scanner& scanner,
+               std::string_view name,
+               T& object,
+               bool& matched)
+{
+    matched = false;
+    bool ok = true;
+    std::apply(
+        [&](const auto&... fields) {
+            auto tryField = [&](const auto& field) {
+                if (field.name != name)
+                {
+                    return false;
+                }
+                using M = std::remove_cv_t<
+                    std::remove_reference_t<decltype(object.*(field.member))>>;
+                matched = true;
+                ok = ClaimTraits<M>::read(scanner, object.*(field.member));
+                return true;
+            };
+            (tryField(fields) || ...);
+        },
+        T::jwtFields);
+    return ok;
+}
+
+/**
+ * @brief Write all the fields of T as the members of a JSON object, without
+ * the braces. The fields for which `skip(name)` returns true are ignored.
+ *
+ * @return Whether anything is written.
+ */
+template <typename String, typename T, typename Skip>
+bool writeFields(String& out, const T& object, Skip&& skip)
+{
+    bool first = true;
+    std::apply(
+        [&](const auto&... fields) {
+            auto writeField = [&](const auto& field) {
+                const auto& value = object.*(field.member);
+                if (skip(field.name) || !isPresent(value))
+                {
+                    return;
+                }
+                if (!first)
+                {
+                    out += ',';
+                }
+                first = false;
+                json::writeString(out, field.name);
+                out += ':';
+                using M = std::remove_cv_t<
+                    std::remove_reference_t<decltype(value)>>;
+                ClaimTraits<M>::write(out, value);
+            };
+            (writeField(fields), ...);
+        },
+        T::jwtFields);
+    return !first;
+}
+}  // namespace detail
+
+}  // namespace tl::jwt
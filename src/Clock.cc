@@ -0,0 +1,49 @@
+/**
+ * @file Clock.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "Clock.h"
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+/// The timestamp of the current loop, 0 if it is not attached. It is shared
+/// by all the CoarseClocks, which set the same value.
+thread_local int64_t loopNow = 0;
+
+void refresh()
+{
+    loopNow = static_cast<int64_t>(time(nullptr));
+}
+}  // namespace
+
+int64_t CoarseClock::now() const
+{
+    auto now = loopNow;
+    return now != 0 ? now : static_cast<int64_t>(time(nullptr));
+}
+
+void CoarseClock::attach(trantor::EventLoop* loop)
+{
+    loop->runInLoop(refresh);
+    auto timerId = loop->runEvery(interval_, refresh);
+    lock_guard<mutex> lock(mutex_);
+    timers_.emplace_back(loop, timerId);
+}
+
+void CoarseClock::detach()
+{
+    lock_guard<mutex> lock(mutex_);
+    for (auto [loop, timerId] : timers_)
+    {
+        loop->invalidateTimer(timerId);
+        // the timestamp is stale from now on
+        loop->runInLoop([]() { loopNow = 0; });
+    }
+    timers_.clear();
+}
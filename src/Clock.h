@@ -0,0 +1,122 @@
+/**
+ * @file Clock.h
+ * @brief The sources of the current time, which is used to set and check the
+ * time claims.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <trantor/net/EventLoop.h>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace tl::jwt
+{
+
+/**
+ * @brief The current time in seconds since the epoch. It is called by every
+ * encode() and decode(), from any thread.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class Clock
+{
+  public:
+    virtual ~Clock() = default;
+
+    virtual int64_t now() const = 0;
+};
+
+/**
+ * @brief time(nullptr), which is the default clock.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class SystemClock : public Clock
+{
+  public:
+    int64_t now() const override
+    {
+        return static_cast<int64_t>(time(nullptr));
+    }
+};
+
+/**
+ * @brief A clock which is only changed by hand, for the tests and the
+ * benchmarks.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class ManualClock : public Clock
+{
+  public:
+    explicit ManualClock(int64_t now = 0) : now_(now)
+    {
+    }
+
+    int64_t now() const override
+    {
+        return now_.load(std::memory_order_relaxed);
+    }
+
+    void set(int64_t now)
+    {
+        now_.store(now, std::memory_order_relaxed);
+    }
+
+    void advance(int64_t seconds)
+    {
+        now_.fetch_add(seconds, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<int64_t> now_;
+};
+
+/**
+ * @brief A timestamp of each IO loop, which is refreshed by a timer of the
+ * loop every `interval` seconds, so reading it is a load of a thread local
+ * variable. It is behind the real time by up to `interval` seconds. The
+ * threads which are not attached read time(nullptr).
+ *
+ * The timers do not refer to the clock, but they keep running until
+ * detach() is called.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class CoarseClock : public Clock
+{
+  public:
+    explicit CoarseClock(double interval = 0.1) : interval_(interval)
+    {
+    }
+
+    CoarseClock(const CoarseClock&) = delete;
+    CoarseClock& operator=(const CoarseClock&) = delete;
+
+    int64_t now() const override;
+
+    /// Refresh the timestamp of the loop by a timer, which is thread safe.
+    void attach(trantor::EventLoop* loop);
+
+    /// Stop all the timers, the attached loops must be alive.
+    void detach();
+
+  private:
+    double interval_;
+    std::mutex mutex_;
+    std::vector<std::pair<trantor::EventLoop*, trantor::TimerId>> timers_;
+};
+
+}  // namespace tl::jwt
@@ -0,0 +1,592 @@
+/**
+ * @file Cwt.cc
+ * @brief CBOR Web Token (RFC 8392) in COSE_Mac0 (RFC 9052) format.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include <drogon/utils/Utilities.h>
+#include "Cbor.h"
+#include "JwtUtil.h"
+#include "KeySet.h"
+
+using namespace std;
+using namespace drogon::utils;
+
+using namespace tl::jwt;
+
+namespace
+{
+/// CWT tag, RFC 8392 §6
+constexpr uint64_t cwtTag = 61;
+/// COSE_Mac0 tag, RFC 9052 §4.3
+constexpr uint64_t mac0Tag = 17;
+
+/// The protected header, which is a bstr of {1: alg}, alg is 5, 6 or 7 for
+/// HMAC 256/256, HMAC 384/384 and HMAC 512/512, RFC 9053 §3.1.
+const unordered_map<Algorithm, string> protectedHeaderList{
+    {HS256, "\xa1\x01\x05"},
+    {HS384, "\xa1\x01\x06"},
+    {HS512, "\xa1\x01\x07"},
+};
+
+/// The label of the key identifier in a header, RFC 9052 §3.1
+constexpr uint64_t kidLabel = 4;
+
+const unordered_map<Algorithm, int64_t> coseAlgorithmList{
+    {HS256, 5},
+    {HS384, 6},
+    {HS512, 7},
+};
+
+/// The claim keys registered by RFC 8392 §4, "cti" is used for "jti".
+constexpr string_view claimNames[] =
+    {"", "iss", "sub", "aud", "exp", "nbf", "iat", "jti"};
+
+/// The integer key of a registered claim, or 0.
+int claimKey(string_view name)
+{
+    for (int i = 1; i < 8; ++i)
+    {
+        if (claimNames[i] == name)
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void writeClaimKey(pmr::string& out, string_view name)
+{
+    if (auto key = claimKey(name))
+    {
+        cbor::writeInt(out, key);
+    }
+    else
+    {
+        cbor::writeText(out, name);
+    }
+}
+
+void writeCbor(pmr::string& out, const Json::Value& value)
+{
+    switch (value.type())
+    {
+        case Json::nullValue:
+            out += static_cast<char>(cbor::Null);
+            break;
+        case Json::intValue:
+            cbor::writeInt(out, value.asLargestInt());
+            break;
+        case Json::uintValue:
+            cbor::writeHead(out, cbor::UnsignedInt, value.asLargestUInt());
+            break;
+        case Json::realValue:
+            cbor::writeDouble(out, value.asDouble());
+            break;
+        case Json::stringValue:
+        {
+            const char *begin, *end;
+            value.getString(&begin, &end);
+            cbor::writeText(out, string_view(begin, end - begin));
+            break;
+        }
+        case Json::booleanValue:
+            out += static_cast<char>(value.asBool() ? cbor::True : cbor::False);
+            break;
+        case Json::arrayValue:
+            cbor::writeHead(out, cbor::Array, value.size());
+            for (const auto& item : value)
+            {
+                writeCbor(out, item);
+            }
+            break;
+        case Json::objectValue:
+            cbor::writeHead(out, cbor::Map, value.size());
+            for (auto it = value.begin(); it != value.end(); ++it)
+            {
+                const char* end;
+                auto name = it.memberName(&end);
+                cbor::writeText(out, string_view(name, end - name));
+                writeCbor(out, *it);
+            }
+            break;
+    }
+}
+
+bool readCbor(cbor::Reader& reader, Json::Value& value, int depth = 0);
+
+/// Read a map key, the integer keys of the registered claims are named.
+bool readKey(cbor::Reader& reader, string& name, bool claims)
+{
+    if (reader.peekType() == cbor::TextString)
+    {
+        string_view text;
+        if (!reader.readString(cbor::TextString, text))
+        {
+            return false;
+        }
+        name.assign(text);
+        return true;
+    }
+    Json::Value key;
+    if (!readCbor(reader, key) || !key.isIntegral())
+    {
+        return false;
+    }
+    auto k = key.asLargestInt();
+    if (claims && k > 0 && k < 8)
+    {
+        name.assign(claimNames[k]);
+    }
+    else
+    {
+        name = to_string(k);
+    }
+    return true;
+}
+
+bool readCbor(cbor::Reader& reader, Json::Value& value, int depth)
+{
+    if (depth > cbor::Reader::maxDepth)
+    {
+        return false;
+    }
+    if (reader.peekType() == cbor::Simple)
+    {
+        double d;
+        if (reader.readFloat(d))
+        {
+            value = d;
+            return true;
+        }
+        uint8_t simple;
+        if (!reader.readSimple(simple))
+        {
+            return false;
+        }
+        switch (simple)
+        {
+            case cbor::True:
+                value = true;
+                return true;
+            case cbor::False:
+                value = false;
+                return true;
+            default:
+                // null, undefined and the unassigned values
+                value = Json::Value();
+                return true;
+        }
+    }
+
+    cbor::MajorType type;
+    uint64_t argument;
+    // peek the head of strings, they are read without copying
+    if (reader.peekType() == cbor::ByteString ||
+        reader.peekType() == cbor::TextString)
+    {
+        auto stringType = static_cast<cbor::MajorType>(reader.peekType());
+        string_view str;
+        if (!reader.readString(stringType, str))
+        {
+            return false;
+        }
+        value = stringType == cbor::TextString
+                    ? Json::Value(str.data(), str.data() + str.size())
+                    : Json::Value(base64Encode(str, true, false));
+        return true;
+    }
+    if (!reader.readHead(type, argument))
+    {
+        return false;
+    }
+    switch (type)
+    {
+        case cbor::UnsignedInt:
+            value = Json::Value(static_cast<Json::UInt64>(argument));
+            return true;
+        case cbor::NegativeInt:
+            if (argument > static_cast<uint64_t>(INT64_MAX))
+            {
+                return false;
+            }
+            value = Json::Value(-1 - static_cast<Json::Int64>(argument));
+            return true;
+        case cbor::Array:
+            value = Json::Value(Json::arrayValue);
+            for (uint64_t i = 0; i < argument; ++i)
+            {
+                if (!readCbor(reader, value.append(Json::Value()), depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        case cbor::Map:
+        {
+            value = Json::Value(Json::objectValue);
+            string name;
+            for (uint64_t i = 0; i < argument; ++i)
+            {
+                if (!readKey(reader, name, false) ||
+                    !readCbor(reader, value[name], depth + 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case cbor::Tag:
+            // the tags inside claims, e.g. date/time, are ignored
+            return readCbor(reader, value, depth + 1);
+        default:
+            return false;
+    }
+}
+
+/// Read the unprotected header, and its kid if there is one. The other
+/// labels are skipped.
+bool readUnprotectedHeader(cbor::Reader& reader, string_view& kid)
+{
+    cbor::MajorType type;
+    uint64_t count, label;
+    if (!reader.expect(cbor::Map, count))
+    {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        if (reader.peekType() == cbor::UnsignedInt)
+        {
+            if (!reader.readHead(type, label))
+            {
+                return false;
+            }
+            if (label == kidLabel)
+            {
+                if (!reader.readString(cbor::ByteString, kid))
+                {
+                    return false;
+                }
+                continue;
+            }
+        }
+        else if (!reader.skip())
+        {
+            return false;
+        }
+        if (!reader.skip())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Start the MAC of MAC_structure = ["MAC0", protected, external_aad, payload]
+template <typename Hash>
+void updateMacStructure(Hash& ctx,
+                        string_view protectedHeader,
+                        string_view payload)
+{
+    char head[16];
+    struct Buffer
+    {
+        char* p;
+
+        void append(const char* data, size_t len)
+        {
+            memcpy(p, data, len);
+            p += len;
+        }
+
+        Buffer& operator+=(char c)
+        {
+            *p++ = c;
+            return *this;
+        }
+    } buffer{head};
+    buffer += static_cast<char>(0x84);
+    cbor::writeText(buffer, "MAC0");
+    ctx.update(head, buffer.p - head);
+
+    buffer.p = head;
+    cbor::writeHead(buffer, cbor::ByteString, protectedHeader.size());
+    ctx.update(head, buffer.p - head);
+    ctx.update(protectedHeader.data(), protectedHeader.size());
+
+    buffer.p = head;
+    // external_aad is empty
+    cbor::writeHead(buffer, cbor::ByteString, 0);
+    cbor::writeHead(buffer, cbor::ByteString, payload.size());
+    ctx.update(head, buffer.p - head);
+    ctx.update(payload.data(), payload.size());
+}
+
+/// Compute the MAC, write it to out and return its size.
+size_t coseMac(const HmacKey& key,
+               string_view protectedHeader,
+               string_view payload,
+               unsigned char* out)
+{
+    return visit(
+        [&](const auto& hmac) {
+            auto ctx = hmac.begin();
+            updateMacStructure(ctx, protectedHeader, payload);
+            hmac.finish(ctx, out);
+            return hmac.digestSize;
+        },
+        key);
+}
+}  // namespace
+
+string JwtUtil::encodeCwt(const Json::Value& data)
+{
+    auto config = snapshot();
+    if (isAsymmetric(config->alg_))
+    {
+        // only COSE_Mac0 is supported
+        throw invalid_argument("CWT requires a HMAC algorithm");
+    }
+    if (!data.isObject() && !data.isNull())
+    {
+        throw invalid_argument("The payload must be an object");
+    }
+
+    // count the claims first, the length of a map is written in its head
+    uint64_t count = 0;
+    for (auto it = data.begin(); it != data.end(); ++it)
+    {
+        const char* end;
+        auto name = it.memberName(&end);
+        if (!config->isOverridden(string_view(name, end - name)))
+        {
+            ++count;
+        }
+    }
+    for (auto name : {"iss", "sub", "aud", "iat", "exp", "nbf", "jti"})
+    {
+        if (config->isOverridden(name))
+        {
+            ++count;
+        }
+    }
+
+    detail::Arena arena;
+    pmr::string payload(&arena);
+    cbor::writeHead(payload, cbor::Map, count);
+    for (auto it = data.begin(); it != data.end(); ++it)
+    {
+        const char* end;
+        auto begin = it.memberName(&end);
+        auto name = string_view(begin, end - begin);
+        if (config->isOverridden(name))
+        {
+            continue;
+        }
+        writeClaimKey(payload, name);
+        if (name == "jti" && it->isString())
+        {
+            cbor::writeBytes(payload, it->asString());
+        }
+        else
+        {
+            writeCbor(payload, *it);
+        }
+    }
+    if (!config->iss_.empty())
+    {
+        writeClaimKey(payload, "iss");
+        cbor::writeText(payload, config->iss_);
+    }
+    if (!config->sub_.empty())
+    {
+        writeClaimKey(payload, "sub");
+        cbor::writeText(payload, config->sub_);
+    }
+    if (!config->aud_.empty())
+    {
+        writeClaimKey(payload, "aud");
+        cbor::writeText(payload, config->aud_);
+    }
+    // get current time
+    auto iat = config->clock_->now();
+    writeClaimKey(payload, "iat");
+    cbor::writeInt(payload, iat);
+    if (config->exp_ >= 0)
+    {
+        writeClaimKey(payload, "exp");
+        cbor::writeInt(payload, config->exp_ + iat);
+    }
+    if (config->nbf_ >= 0)
+    {
+        writeClaimKey(payload, "nbf");
+        cbor::writeInt(payload, config->nbf_ + iat);
+    }
+    if (config->jti_)
+    {
+        writeClaimKey(payload, "jti");
+        cbor::writeBytes(payload, getUuid());
+    }
+
+    const auto& protectedHeader = protectedHeaderList.at(config->alg_);
+    unsigned char digest[sha2::Sha512::digestSize];
+    auto size = coseMac(config->key_, protectedHeader, payload, digest);
+
+    string result;
+    result.reserve(payload.size() + protectedHeader.size() + size + 16);
+    cbor::writeHead(result, cbor::Tag, cwtTag);
+    cbor::writeHead(result, cbor::Tag, mac0Tag);
+    cbor::writeHead(result, cbor::Array, 4);
+    cbor::writeBytes(result, protectedHeader);
+    // the unprotected header has the kid of the signing key of a set
+    if (config->keys_)
+    {
+        cbor::writeHead(result, cbor::Map, 1);
+        cbor::writeHead(result, cbor::UnsignedInt, kidLabel);
+        cbor::writeBytes(result, config->keys_->signingKey().kid);
+    }
+    else
+    {
+        cbor::writeHead(result, cbor::Map, 0);
+    }
+    cbor::writeBytes(result, payload);
+    cbor::writeBytes(
+        result, string_view(reinterpret_cast<const char*>(digest), size));
+    return result;
+}
+
+pair<Result, shared_ptr<Json::Value>> JwtUtil::decodeCwt(string_view token)
+{
+    auto config = snapshot();
+    if (isAsymmetric(config->alg_))
+    {
+        return {InvalidAlgorithm, nullptr};
+    }
+    cbor::Reader reader(token);
+    cbor::MajorType type;
+    uint64_t value;
+    // both of the tags are optional
+    for (auto tag : {cwtTag, mac0Tag})
+    {
+        if (reader.peekType() == cbor::Tag)
+        {
+            if (!reader.readHead(type, value) || value != tag)
+            {
+                return {InvalidToken, nullptr};
+            }
+        }
+    }
+    string_view protectedHeader, kid, payload, tag;
+    if (!reader.expect(cbor::Array, value) || value != 4 ||
+        !reader.readString(cbor::ByteString, protectedHeader) ||
+        !readUnprotectedHeader(reader, kid) ||
+        !reader.readString(cbor::ByteString, payload) ||
+        !reader.readString(cbor::ByteString, tag) || !reader.atEnd())
+    {
+        return {InvalidToken, nullptr};
+    }
+
+    // the tokens of the other keys of the set
+    auto algorithm = config->alg_;
+    const auto* hmac = &config->key_;
+    if (config->keys_ && !kid.empty())
+    {
+        const auto* key = config->keys_->find(kid);
+        if (!key)
+        {
+            return {InvalidSignature, nullptr};
+        }
+        algorithm = key->alg;
+        hmac = &key->hmac;
+    }
+
+    // check header
+    if (protectedHeader != protectedHeaderList.at(algorithm))
+    {
+        cbor::Reader headerReader(protectedHeader);
+        Json::Value header;
+        if (!readCbor(headerReader, header) || !headerReader.atEnd() ||
+            !header.isObject())
+        {
+            return {InvalidHeader, nullptr};
+        }
+        if (!header["1"].isIntegral() ||
+            header["1"].asLargestInt() != coseAlgorithmList.at(algorithm))
+        {
+            return {InvalidAlgorithm, nullptr};
+        }
+    }
+
+    unsigned char digest[sha2::Sha512::digestSize];
+    auto size = coseMac(*hmac, protectedHeader, payload, digest);
+    if (tag != string_view(reinterpret_cast<const char*>(digest), size))
+    {
+        return {InvalidSignature, nullptr};
+    }
+
+    // decode payload
+    cbor::Reader payloadReader(payload);
+    auto payloadValue = make_shared<Json::Value>(Json::objectValue);
+    if (!payloadReader.expect(cbor::Map, value))
+    {
+        return {InvalidPayload, nullptr};
+    }
+    string name;
+    optional<int64_t> exp, nbf;
+    for (uint64_t i = 0; i < value; ++i)
+    {
+        if (!readKey(payloadReader, name, true))
+        {
+            return {InvalidPayload, nullptr};
+        }
+        auto& claim = (*payloadValue)[name];
+        // cti is a byte string, which is the jti written by encodeCwt()
+        if (name == "jti" && payloadReader.peekType() == cbor::ByteString)
+        {
+            string_view cti;
+            if (!payloadReader.readString(cbor::ByteString, cti))
+            {
+                return {InvalidPayload, nullptr};
+            }
+            claim = Json::Value(cti.data(), cti.data() + cti.size());
+            continue;
+        }
+        if (!readCbor(payloadReader, claim))
+        {
+            return {InvalidPayload, nullptr};
+        }
+        if (!detail::readTimeClaim(name, claim, exp, nbf))
+        {
+            return {InvalidPayload, nullptr};
+        }
+    }
+    if (!payloadReader.atEnd())
+    {
+        return {InvalidPayload, nullptr};
+    }
+
+    auto result = config->validateTime(exp, nbf);
+    if (result == Ok && config->policy_)
+    {
+        result = config->policy_->check(*payloadValue);
+    }
+    if (result != Ok)
+    {
+        return {result, nullptr};
+    }
+
+    Json::Value temp;
+    if (exp)
+    {
+        payloadValue->removeMember("exp", &temp);
+    }
+    if (nbf)
+    {
+        payloadValue->removeMember("nbf", &temp);
+    }
+    payloadValue->removeMember("iat", &temp);
+    return {Ok, payloadValue};
+}
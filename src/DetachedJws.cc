@@ -0,0 +1,216 @@
+/**
+ * @file DetachedJws.cc
+ * @brief The JWS with a detached and unencoded payload (RFC 7797).
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "JwtUtil.h"
+#include <cstring>
+#include <stdexcept>
+#include "Base64Url.h"
+#include "KeySet.h"
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+constexpr size_t maxDigestSize = sha2::Sha512::digestSize;
+
+/// The fields of a detached header.
+struct DetachedHeader
+{
+    string alg;
+    string kid;
+    bool b64{true};
+    /// "crit" is ["b64"].
+    bool critB64{false};
+};
+
+/// Parse the header, return InvalidHeader if it is malformed.
+Result parseDetachedHeader(string_view encoded, DetachedHeader& header)
+{
+    string decoded(base64url::decodedLength(encoded.size()), '\0');
+    auto length = base64url::decode(encoded, decoded.data());
+    if (length < 0)
+    {
+        return InvalidHeader;
+    }
+    decoded.resize(length);
+
+    json::Scanner scanner(decoded);
+    bool valid = true;
+    auto ok = scanner.forEachMember([&](auto key, json::Scanner& s) {
+        auto copy = s;
+        if (key == "alg")
+        {
+            valid = valid && copy.readString(header.alg);
+        }
+        else if (key == "kid")
+        {
+            valid = valid && copy.readString(header.kid);
+        }
+        else if (key == "b64")
+        {
+            valid = valid && copy.readBool(header.b64);
+        }
+        else if (key == "crit")
+        {
+            // the only extension which is understood
+            bool onlyB64 = true;
+            size_t count = 0;
+            valid = valid &&
+                    copy.forEachElement([&](json::Scanner& element) {
+                        string name;
+                        if (!element.readString(name))
+                        {
+                            return false;
+                        }
+                        onlyB64 = onlyB64 && name == "b64";
+                        ++count;
+                        return true;
+                    });
+            header.critB64 = onlyB64 && count == 1;
+        }
+        return s.skipValue();
+    });
+    if (!ok || !valid || !scanner.atEnd() || header.b64 || !header.critB64)
+    {
+        return InvalidHeader;
+    }
+    return Ok;
+}
+}  // namespace
+
+detail::HmacStream::HmacStream(const HmacKey& key)
+{
+    visit(
+        [this](const auto& hmac) {
+            using Hmac = decay_t<decltype(hmac)>;
+            const auto& copy = key_.emplace<Hmac>(hmac);
+            context_.emplace<decltype(copy.begin())>(copy.begin());
+        },
+        key);
+}
+
+void detail::HmacStream::update(string_view data)
+{
+    visit([data](auto& context) { context.update(data.data(), data.size()); },
+          context_);
+}
+
+size_t detail::HmacStream::finish(unsigned char* out)
+{
+    return visit(
+        [this, out](const auto& hmac) {
+            using Context = decltype(hmac.begin());
+            hmac.finish(get<Context>(context_), out);
+            return hmac.digestSize;
+        },
+        key_);
+}
+
+DetachedSigner::DetachedSigner(string header, const HmacKey& key)
+    : header_(std::move(header)), stream_(key)
+{
+    stream_.update(header_);
+    stream_.update(".");
+}
+
+string DetachedSigner::finish()
+{
+    unsigned char digest[maxDigestSize];
+    auto size = stream_.finish(digest);
+    string token(header_.size() + 2 + base64url::encodedLength(size), '.');
+    memcpy(token.data(), header_.data(), header_.size());
+    base64url::encode(digest, size, token.data() + header_.size() + 2);
+    return token;
+}
+
+DetachedVerifier::DetachedVerifier(string_view signature, const HmacKey& key)
+    : signature_(signature), stream_(std::in_place, key)
+{
+}
+
+Result DetachedVerifier::finish()
+{
+    if (error_ != Ok)
+    {
+        return error_;
+    }
+    unsigned char digest[maxDigestSize];
+    auto size = stream_->finish(digest);
+    char expected[base64url::encodedLength(maxDigestSize)];
+    base64url::encode(digest, size, expected);
+    return signature_ ==
+                   string_view(expected, base64url::encodedLength(size))
+               ? Ok
+               : InvalidSignature;
+}
+
+DetachedSigner JwtUtil::signDetached()
+{
+    auto config = snapshot();
+    if (isAsymmetric(config->alg_))
+    {
+        throw invalid_argument("Detached payloads require a HMAC algorithm");
+    }
+    pmr::string json;
+    json += "{\"alg\":\"" + toString(config->alg_) + "\"";
+    if (config->keys_)
+    {
+        json += ",\"kid\":";
+        json::writeString(json, config->keys_->signingKey().kid);
+    }
+    json += ",\"b64\":false,\"crit\":[\"b64\"]}";
+    string header(base64url::encodedLength(json.size()), '\0');
+    base64url::encode(json.data(), json.size(), header.data());
+    return DetachedSigner(std::move(header), config->key_);
+}
+
+DetachedVerifier JwtUtil::verifyDetached(string_view token)
+{
+    auto config = snapshot();
+    auto dot = token.find('.');
+    if (dot == 0 || dot == string_view::npos || dot + 2 >= token.size() ||
+        token[dot + 1] != '.')
+    {
+        return DetachedVerifier(InvalidToken);
+    }
+    auto encodedHeader = token.substr(0, dot);
+    auto signature = token.substr(dot + 2);
+
+    DetachedHeader header;
+    auto result = parseDetachedHeader(encodedHeader, header);
+    if (result != Ok)
+    {
+        return DetachedVerifier(result);
+    }
+    if (isAsymmetric(config->alg_))
+    {
+        return DetachedVerifier(InvalidAlgorithm);
+    }
+    auto algorithm = config->alg_;
+    const auto* hmac = &config->key_;
+    if (config->keys_ && !header.kid.empty())
+    {
+        const auto* key = config->keys_->find(header.kid);
+        if (!key)
+        {
+            return DetachedVerifier(InvalidSignature);
+        }
+        algorithm = key->alg;
+        hmac = &key->hmac;
+    }
+    if (header.alg != toString(algorithm))
+    {
+        return DetachedVerifier(InvalidAlgorithm);
+    }
+
+    DetachedVerifier verifier(signature, *hmac);
+    verifier.update(encodedHeader);
+    verifier.update(".");
+    return verifier;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file Hmac.h
+ * @brief HMAC (RFC 2104) over the incremental sha2 contexts.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <cstring>
+#include <string_view>
+#include "sha2.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief A HMAC key, whose ipad and opad blocks are hashed once when it is
+ * created. Signing a message only hashes the message and the inner digest.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename Hash>
+class Hmac
+{
+  public:
+    static constexpr size_t digestSize = Hash::digestSize;
+
+    Hmac() : Hmac(std::string_view())
+    {
+    }
+
+    explicit Hmac(std::string_view secret)
+    {
+        unsigned char K[Hash::blockSize] = {0};
+        if (secret.size() > Hash::blockSize)
+        {
+            Hash keyHash;
+            keyHash.update(secret.data(), secret.size());
+            keyHash.final(K);
+        }
+        else if (!secret.empty())
+        {
+            std::memcpy(K, secret.data(), secret.size());
+        }
+
+        unsigned char pad[Hash::blockSize];
+        for (size_t i = 0; i < Hash::blockSize; ++i)
+        {
+            pad[i] = K[i] ^ 0x36;
+        }
+        inner_.update(pad, sizeof(pad));
+        for (size_t i = 0; i < Hash::blockSize; ++i)
+        {
+            pad[i] = K[i] ^ 0x5c;
+        }
+        outer_.update(pad, sizeof(pad));
+    }
+
+    /// Start a new incremental signing, the message is fed by update().
+    Hash begin() const
+    {
+        return inner_;
+    }
+
+    /// Finish the incremental signing, write digestSize bytes to out.
+    void finish(Hash& inner, unsigned char* out) const
+    {
+        unsigned char innerDigest[digestSize];
+        inner.final(innerDigest);
+        auto outer = outer_;
+        outer.update(innerDigest, digestSize);
+        outer.final(out);
+    }
+
+    /// Sign the message, write digestSize bytes to out.
+    void sign(std::string_view message, unsigned char* out) const
+    {
+        auto inner = begin();
+        inner.update(message.data(), message.size());
+        finish(inner, out);
+    }
+
+  private:
+    Hash inner_;
+    Hash outer_;
+};
+
+}  // namespace tl::jwt
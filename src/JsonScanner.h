@@ -0,0 +1,588 @@
+/**
+ * @file JsonScanner.h
+ * @brief A minimal forward-only JSON scanner and writer, used to read and
+ * write jwt payloads without building a Json::Value tree.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace tl::jwt::json
+{
+
+/**
+ * @brief Reads JSON values one by one from a text buffer. Every read method
+ * skips the leading white spaces, returns false on malformed input and leaves
+ * the position undefined in that case.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class Scanner
+{
+  public:
+    explicit Scanner(std::string_view text)
+        : cur_(text.data()), end_(text.data() + text.size())
+    {
+    }
+
+    void skipSpaces()
+    {
+        while (cur_ != end_ &&
+               (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r'))
+        {
+            ++cur_;
+        }
+    }
+
+    /// Skip the white spaces, and consume the next char if it is `c`.
+    bool consume(char c)
+    {
+        skipSpaces();
+        if (cur_ != end_ && *cur_ == c)
+        {
+            ++cur_;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c)
+    {
+        skipSpaces();
+        return cur_ != end_ && *cur_ == c;
+    }
+
+    bool atEnd()
+    {
+        skipSpaces();
+        return cur_ == end_;
+    }
+
+    const char* position() const
+    {
+        return cur_;
+    }
+
+    /**
+     * @brief Read a string without unescaping it.
+     *
+     * @param raw The content between the quotes.
+     * @param escaped Set to true if the content contains escape sequences.
+     */
+    bool readRawString(std::string_view& raw, bool& escaped)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        escaped = false;
+        auto begin = cur_;
+        while (cur_ != end_ && *cur_ != '"')
+        {
+            if (static_cast<unsigned char>(*cur_) < 0x20)
+            {
+                return false;
+            }
+            if (*cur_ == '\\')
+            {
+                escaped = true;
+                if (++cur_ == end_)
+                {
+                    return false;
+                }
+            }
+            ++cur_;
+        }
+        if (cur_ == end_)
+        {
+            return false;
+        }
+        raw = std::string_view(begin, cur_ - begin);
+        ++cur_;
+        return true;
+    }
+
+    bool readString(std::string& out)
+    {
+        std::string_view raw;
+        bool escaped;
+        if (!readRawString(raw, escaped))
+        {
+            return false;
+        }
+        if (!escaped)
+        {
+            out.assign(raw);
+            return true;
+        }
+        return unescape(raw, out);
+    }
+
+    bool readBool(bool& out)
+    {
+        skipSpaces();
+        if (matchLiteral("true"))
+        {
+            out = true;
+            return true;
+        }
+        if (matchLiteral("false"))
+        {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool readNull()
+    {
+        skipSpaces();
+        return matchLiteral("null");
+    }
+
+    /// Read a number which has an integral value, `1e3` and `2.0` are allowed.
+    bool readInt64(int64_t& out)
+    {
+        skipSpaces();
+        auto end = numberEnd();
+        if (!end)
+        {
+            return false;
+        }
+        auto [ptr, ec] = std::from_chars(cur_, end, out);
+        if (ec == std::errc() && ptr == end)
+        {
+            cur_ = ptr;
+            return true;
+        }
+        double value;
+        if (!readDouble(value) || value != std::floor(value) ||
+            value < -9223372036854775808.0 || value >= 9223372036854775808.0)
+        {
+            return false;
+        }
+        out = static_cast<int64_t>(value);
+        return true;
+    }
+
+    /// Read a finite number, the ones out of the range of double are refused.
+    bool readDouble(double& out)
+    {
+        skipSpaces();
+        auto end = numberEnd();
+        if (!end)
+        {
+            return false;
+        }
+        auto [ptr, ec] =
+            std::from_chars(cur_, end, out, std::chars_format::general);
+        if (ec != std::errc() || ptr != end || !std::isfinite(out))
+        {
+            return false;
+        }
+        cur_ = ptr;
+        return true;
+    }
+
+    /// Skip a whole value, including the nested objects and arrays.
+    bool skipValue(int depth = 0)
+    {
+        if (depth > maxDepth)
+        {
+            return false;
+        }
+        skipSpaces();
+        if (cur_ == end_)
+        {
+            return false;
+        }
+        switch (*cur_)
+        {
+            case '"':
+            {
+                std::string_view raw;
+                bool escaped;
+                return readRawString(raw, escaped);
+            }
+            case '{':
+                return forEachMember([depth](std::string_view, Scanner& s) {
+                    return s.skipValue(depth + 1);
+                });
+            case '[':
+                return forEachElement(
+                    [depth](Scanner& s) { return s.skipValue(depth + 1); });
+            case 't':
+            case 'f':
+            {
+                bool b;
+                return readBool(b);
+            }
+            case 'n':
+                return readNull();
+            default:
+            {
+                double d;
+                return readDouble(d);
+            }
+        }
+    }
+
+    /**
+     * @brief Iterate the members of an object. `f` is called with the
+     * unescaped key and the scanner positioned before the value, and must
+     * consume the value and return true, or return false to stop with error.
+     */
+    template <typename F>
+    bool forEachMember(F&& f)
+    {
+        if (!consume('{'))
+        {
+            return false;
+        }
+        if (consume('}'))
+        {
+            return true;
+        }
+        std::string unescaped;
+        do
+        {
+            std::string_view key;
+            bool escaped;
+            if (!readRawString(key, escaped))
+            {
+                return false;
+            }
+            if (escaped)
+            {
+                if (!unescape(key, unescaped))
+                {
+                    return false;
+                }
+                key = unescaped;
+            }
+            if (!consume(':') || !f(key, *this))
+            {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+    /// The same as forEachMember, but for the elements of an array.
+    template <typename F>
+    bool forEachElement(F&& f)
+    {
+        if (!consume('['))
+        {
+            return false;
+        }
+        if (consume(']'))
+        {
+            return true;
+        }
+        do
+        {
+            if (!f(*this))
+            {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']');
+    }
+
+    static constexpr int maxDepth = 64;
+
+  private:
+    static bool isDigit(const char* p, const char* end)
+    {
+        return p != end && *p >= '0' && *p <= '9';
+    }
+
+    /**
+     * @brief The end of the number at the position by the grammar of RFC 8259,
+     * which has no leading zeros, no `inf` or `nan`, and at least one digit
+     * after `.` and `e`. from_chars() accepts all of them.
+     *
+     * @return nullptr if it is not a number.
+     */
+    const char* numberEnd() const
+    {
+        auto p = cur_;
+        if (p != end_ && *p == '-')
+        {
+            ++p;
+        }
+        if (!isDigit(p, end_))
+        {
+            return nullptr;
+        }
+        if (*p++ != '0')
+        {
+            while (isDigit(p, end_))
+            {
+                ++p;
+            }
+        }
+        if (p != end_ && *p == '.')
+        {
+            if (!isDigit(++p, end_))
+            {
+                return nullptr;
+            }
+            while (isDigit(p, end_))
+            {
+                ++p;
+            }
+        }
+        if (p != end_ && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            if (p != end_ && (*p == '+' || *p == '-'))
+            {
+                ++p;
+            }
+            if (!isDigit(p, end_))
+            {
+                return nullptr;
+            }
+            while (isDigit(p, end_))
+            {
+                ++p;
+            }
+        }
+        // "01" is a zero followed by garbage
+        if (isDigit(p, end_))
+        {
+            return nullptr;
+        }
+        return p;
+    }
+
+    bool matchLiteral(std::string_view literal)
+    {
+        if (static_cast<size_t>(end_ - cur_) < literal.size() ||
+            std::string_view(cur_, literal.size()) != literal)
+        {
+            return false;
+        }
+        cur_ += literal.size();
+        return true;
+    }
+
+    static int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool readHex4(std::string_view raw, size_t pos, uint32_t& out)
+    {
+        if (pos + 4 > raw.size())
+        {
+            return false;
+        }
+        out = 0;
+        for (size_t i = pos; i < pos + 4; ++i)
+        {
+            auto v = hexValue(raw[i]);
+            if (v < 0)
+            {
+                return false;
+            }
+            out = (out << 4) | v;
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            out += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
+    static bool unescape(std::string_view raw, std::string& out)
+    {
+        out.clear();
+        out.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); ++i)
+        {
+            if (raw[i] != '\\')
+            {
+                out += raw[i];
+                continue;
+            }
+            switch (raw[++i])
+            {
+                case '"':
+                case '\\':
+                case '/':
+                    out += raw[i];
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t cp;
+                    if (!readHex4(raw, i + 1, cp))
+                    {
+                        return false;
+                    }
+                    i += 4;
+                    if (cp >= 0xd800 && cp < 0xdc00)
+                    {
+                        uint32_t low;
+                        if (i + 2 >= raw.size() || raw[i + 1] != '\\' ||
+                            raw[i + 2] != 'u' || !readHex4(raw, i + 3, low) ||
+                            low < 0xdc00 || low >= 0xe000)
+                        {
+                            return false;
+                        }
+                        i += 6;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    const char* cur_;
+    const char* end_;
+};
+
+/**
+ * @brief Append `str` to `out` as a quoted and escaped JSON string.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename String>
+void writeString(String& out, std::string_view str)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out += '"';
+    for (auto c : str)
+    {
+        switch (c)
+        {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out += "\\u00";
+                    out += hex[(c >> 4) & 0xf];
+                    out += hex[c & 0xf];
+                }
+                else
+                {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+template <typename String>
+void writeInt(String& out, int64_t value)
+{
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, ptr - buf);
+}
+
+template <typename String>
+void writeUInt(String& out, uint64_t value)
+{
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, ptr - buf);
+}
+
+/// JSON has no representation of inf or nan, they are written as null. The
+/// integral values keep a fraction, e.g. `1.0`, so they are read back as
+/// reals.
+template <typename String>
+void writeDouble(String& out, double value)
+{
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+    char buf[32];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, ptr - buf);
+    if (std::string_view(buf, ptr - buf).find_first_of(".e") ==
+        std::string_view::npos)
+    {
+        out += ".0";
+    }
+}
+
+}  // namespace tl::jwt::json
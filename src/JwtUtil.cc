@@ -6,75 +6,480 @@
  */
 
 #include "JwtUtil.h"
+#include <drogon/HttpAppFramework.h>
 #include <drogon/utils/Utilities.h>
-#include "sha2.h"
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include "Base64Url.h"
+#include "KeySet.h"
 
 using namespace std;
 using namespace drogon::utils;
 
 using namespace tl::jwt;
 
-inline function<string(const string&)> getHashFunc(Algorithm alg)
+namespace
 {
-    switch (alg)
+constexpr size_t maxDigestSize = sha2::Sha512::digestSize;
+
+/// The number of payloads whose tokens are cached by each thread.
+constexpr size_t maxCachedTokens = 64;
+
+/// Sign the message, write the digest to out and return its size.
+size_t hmacSign(const HmacKey& key, string_view message, unsigned char* out)
+{
+    return visit(
+        [message, out](const auto& hmac) {
+            hmac.sign(message, out);
+            return hmac.digestSize;
+        },
+        key);
+}
+
+size_t digestSize(const HmacKey& key)
+{
+    return visit([](const auto& hmac) { return hmac.digestSize; }, key);
+}
+
+/// Copy a key, the keys are not assignable.
+void assignKey(HmacKey& key, const HmacKey& other)
+{
+    visit(
+        [&key](const auto& hmac) {
+            key.emplace<std::decay_t<decltype(hmac)>>(hmac);
+        },
+        other);
+}
+
+/// The fields of a non-canonical header, which are parsed once.
+struct HeaderInfo
+{
+    /// InvalidHeader if it is not JSON, InvalidAlgorithm if it is not an
+    /// object or "alg" is not a string.
+    Result error{Ok};
+    string alg;
+    string kid;
+    bool compressed{false};
+    /// "zip" is not "DEF".
+    bool invalidZip{false};
+};
+
+/// The number of headers which are cached by each thread, the headers of a
+/// few issuers fit in it.
+constexpr size_t maxCachedHeaders = 64;
+
+/// The longer headers are parsed every time, instead of being cached.
+constexpr size_t maxCachedHeaderSize = 512;
+
+HeaderInfo scanHeader(string_view encoded)
+{
+    HeaderInfo info;
+    char decoded[base64url::decodedLength(maxCachedHeaderSize)];
+    string buffer;
+    char* data = decoded;
+    if (encoded.size() > maxCachedHeaderSize)
     {
-        case HS256:
-            return sha2::sha256;
-        case HS384:
-            return sha2::sha384;
-        case HS512:
-            return sha2::sha512;
+        buffer.resize(base64url::decodedLength(encoded.size()));
+        data = buffer.data();
+    }
+    auto length = base64url::decode(encoded, data);
+    if (length < 0)
+    {
+        info.error = InvalidHeader;
+        return info;
+    }
+
+    json::Scanner scanner(string_view(data, length));
+    scanner.skipSpaces();
+    if (!scanner.peek('{'))
+    {
+        // valid JSON, but not an object
+        info.error = scanner.skipValue() && scanner.atEnd() ? InvalidAlgorithm
+                                                            : InvalidHeader;
+        return info;
     }
+    bool hasAlg = false;
+    auto ok = scanner.forEachMember([&info, &hasAlg](auto key,
+                                                     json::Scanner& s) {
+        if (key == "alg")
+        {
+            auto copy = s;
+            hasAlg = copy.readString(info.alg);
+        }
+        else if (key == "kid")
+        {
+            auto copy = s;
+            copy.readString(info.kid);
+        }
+        else if (key == "zip")
+        {
+            auto copy = s;
+            string zip;
+            info.compressed = true;
+            info.invalidZip = !copy.readString(zip) || zip != "DEF";
+        }
+        return s.skipValue();
+    });
+    if (!ok || !scanner.atEnd())
+    {
+        info.error = InvalidHeader;
+    }
+    else if (!hasAlg)
+    {
+        info.error = InvalidAlgorithm;
+    }
+    return info;
+}
+
+struct CachedHeader
+{
+    string encoded;
+    HeaderInfo info;
+};
+
+/**
+ * The non-canonical headers of this thread. A header is only cached after the
+ * signature of its token is verified, so the forged headers never evict the
+ * cached ones, and the slots are replaced round-robin.
+ */
+struct HeaderCache
+{
+    array<CachedHeader, maxCachedHeaders> entries;
+    size_t size{0};
+    size_t next{0};
+    /// The last header which is not cached, whose string keeps its capacity,
+    /// so a miss allocates nothing after the first ones.
+    CachedHeader scratch;
+};
+
+HeaderCache& headerCache()
+{
+    thread_local HeaderCache cache;
+    return cache;
 }
 
-string hmacEncode(const string& secret,
-                  const string& headerAndPayload,
-                  Algorithm alg)
+/// Parse a non-canonical header, through the cache of this thread.
+const HeaderInfo& parseHeader(string_view encoded)
 {
-    auto hashFunc = getHashFunc(alg);
-    // pre processing of the key
-    string K = secret;
-    if ((alg == HS256 && secret.size() > 64) || secret.size() > 128)
+    auto& cache = headerCache();
+    for (size_t i = 0; i < cache.size; ++i)
     {
-        K = hashFunc(secret);
+        if (cache.entries[i].encoded == encoded)
+        {
+            return cache.entries[i].info;
+        }
     }
-    if (alg == HS256 && K.size() < 64)
+    if (cache.scratch.encoded != encoded)
     {
-        K.resize(64, '\0');
+        cache.scratch.encoded.assign(encoded);
+        cache.scratch.info = scanHeader(encoded);
     }
-    else if (K.size() < 128)
+    return cache.scratch.info;
+}
+
+/// Cache the header of a token whose signature is verified, after it is
+/// parsed by parseHeader().
+void cacheHeader(string_view encoded)
+{
+    auto& cache = headerCache();
+    // the long headers are never cached, and a hit is not in the scratch
+    if (encoded.size() > maxCachedHeaderSize ||
+        cache.scratch.encoded != encoded)
     {
-        K.resize(128, '\0');
+        return;
     }
+    swap(cache.entries[cache.next], cache.scratch);
+    cache.scratch.encoded.clear();
+    cache.next = (cache.next + 1) % maxCachedHeaders;
+    cache.size = min(cache.size + 1, maxCachedHeaders);
+}
 
-    // Create ipadkey and opadkey
-    string ipadkey(K.size(), '\0');
-    string opadkey(K.size(), '\0');
-
-    transform(K.begin(), K.end(), ipadkey.begin(), [](const auto c) -> char {
-        return c ^ 0x36;
-    });
-    transform(K.begin(), K.end(), opadkey.begin(), [](const auto c) -> char {
-        return c ^ 0x5c;
+/// Scan the "exp" and "nbf" claims of a payload, and feed the policy in the
+/// same pass, without building a DOM.
+bool scanClaims(string_view payload,
+                optional<int64_t>& exp,
+                optional<int64_t>& nbf,
+                ClaimPolicy::Matcher* matcher)
+{
+    json::Scanner scanner(payload);
+    auto ok = scanner.forEachMember([&](auto key, json::Scanner& s) {
+        if (matcher)
+        {
+            matcher->onMember(key, s);
+        }
+        return detail::readTimeClaim(key, s, exp, nbf) && s.skipValue();
     });
+    return ok && scanner.atEnd();
+}
 
-    // hash(ipadkey + headerAndPayload)
-    auto hash1 = hashFunc(ipadkey + headerAndPayload);
+/// The inflated payload is limited, to refuse the tokens which are tiny but
+/// expand to huge payloads.
+constexpr size_t maxInflatedSize = 1 << 20;
 
-    // hash(opadkey + hash(ipadkey + headerAndPayload))
-    auto hash2 = hashFunc(opadkey + hash1);
-    return base64Encode(hash2, true, false);
+/// The deflate and inflate streams are reused by the calls on the same thread,
+/// to avoid allocating their windows every time. A stream which fails to be
+/// initialized is not ready, and every call on that thread fails.
+struct Deflater
+{
+    Deflater()
+        : ready(deflateInit2(&stream,
+                             Z_DEFAULT_COMPRESSION,
+                             Z_DEFLATED,
+                             -MAX_WBITS,  // raw DEFLATE, RFC 1951
+                             8,
+                             Z_DEFAULT_STRATEGY) == Z_OK)
+    {
+    }
+
+    ~Deflater()
+    {
+        if (ready)
+        {
+            deflateEnd(&stream);
+        }
+    }
+
+    z_stream stream{};
+    bool ready;
+};
+
+struct Inflater
+{
+    Inflater() : ready(inflateInit2(&stream, -MAX_WBITS) == Z_OK)
+    {
+    }
+
+    ~Inflater()
+    {
+        if (ready)
+        {
+            inflateEnd(&stream);
+        }
+    }
+
+    z_stream stream{};
+    bool ready;
+    string buffer;
+};
+
+/// Deflate into out, return false if it fails, then the payload is signed
+/// without compression.
+bool deflatePayload(string_view in, pmr::string& out)
+{
+    thread_local Deflater deflater;
+    if (!deflater.ready)
+    {
+        return false;
+    }
+    auto& stream = deflater.stream;
+    deflateReset(&stream);
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        return false;
+    }
+    out.resize(stream.total_out);
+    return true;
+}
+
+/// Inflate into the per thread buffer, return nullptr if it fails.
+const string* inflatePayload(string_view in)
+{
+    thread_local Inflater inflater;
+    if (!inflater.ready)
+    {
+        return nullptr;
+    }
+    auto& stream = inflater.stream;
+    auto& buffer = inflater.buffer;
+    inflateReset(&stream);
+    stream.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    // sized by the input, not by the capacity which is left by a larger
+    // payload, so only the bytes which are likely written are zeroed
+    buffer.resize(
+        std::min(std::max(in.size() * 4, size_t(64)), maxInflatedSize));
+    while (true)
+    {
+        stream.next_out =
+            reinterpret_cast<Bytef*>(buffer.data() + stream.total_out);
+        stream.avail_out = static_cast<uInt>(buffer.size() - stream.total_out);
+        auto ret = inflate(&stream, Z_FINISH);
+        if (ret == Z_STREAM_END)
+        {
+            break;
+        }
+        // the output is full, otherwise the input is broken or truncated
+        if ((ret != Z_BUF_ERROR && ret != Z_OK) || stream.avail_out != 0 ||
+            buffer.size() >= maxInflatedSize)
+        {
+            return nullptr;
+        }
+        buffer.resize(std::min(buffer.size() * 2, maxInflatedSize));
+    }
+    buffer.resize(stream.total_out);
+    return &buffer;
+}
+
+/// Read a whole PEM file, exit if it can not be read.
+string readFile(const string& path)
+{
+    ifstream file(path, ios::binary);
+    if (!file)
+    {
+        LOG_ERROR << "Can not read the key file: " << path;
+        exit(1);
+    }
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+/// Serialize a Json::Value without indentation.
+void writeJson(pmr::string& out, const Json::Value& value)
+{
+    switch (value.type())
+    {
+        case Json::nullValue:
+            out += "null";
+            break;
+        case Json::intValue:
+            json::writeInt(out, value.asLargestInt());
+            break;
+        case Json::uintValue:
+            json::writeUInt(out, value.asLargestUInt());
+            break;
+        case Json::realValue:
+            json::writeDouble(out, value.asDouble());
+            break;
+        case Json::stringValue:
+        {
+            const char *begin, *end;
+            value.getString(&begin, &end);
+            json::writeString(out, string_view(begin, end - begin));
+            break;
+        }
+        case Json::booleanValue:
+            out += value.asBool() ? "true" : "false";
+            break;
+        case Json::arrayValue:
+            out += '[';
+            for (Json::ArrayIndex i = 0; i < value.size(); ++i)
+            {
+                if (i != 0)
+                {
+                    out += ',';
+                }
+                writeJson(out, value[i]);
+            }
+            out += ']';
+            break;
+        case Json::objectValue:
+            out += '{';
+            for (auto it = value.begin(); it != value.end(); ++it)
+            {
+                if (it != value.begin())
+                {
+                    out += ',';
+                }
+                const char* end;
+                auto name = it.memberName(&end);
+                json::writeString(out, string_view(name, end - name));
+                out += ':';
+                writeJson(out, *it);
+            }
+            out += '}';
+            break;
+    }
+}
+
+/// Truncate a NumericDate, the ones beyond int64 are clamped, and inf or nan
+/// is refused.
+optional<int64_t> toNumericDate(double value)
+{
+    if (!isfinite(value))
+    {
+        return nullopt;
+    }
+    if (value >= 9223372036854775808.0)
+    {
+        return numeric_limits<int64_t>::max();
+    }
+    if (value < -9223372036854775808.0)
+    {
+        return numeric_limits<int64_t>::min();
+    }
+    return static_cast<int64_t>(value);
+}
+}  // namespace
+
+bool detail::readTimeClaim(string_view key,
+                           json::Scanner value,
+                           optional<int64_t>& exp,
+                           optional<int64_t>& nbf)
+{
+    if (key != "exp" && key != "nbf")
+    {
+        return true;
+    }
+    auto& claim = key == "exp" ? exp : nbf;
+    int64_t integer;
+    auto copy = value;
+    if (copy.readInt64(integer))
+    {
+        claim = integer;
+        return true;
+    }
+    double real;
+    if (!value.readDouble(real))
+    {
+        return false;
+    }
+    claim = toNumericDate(real);
+    return claim.has_value();
+}
+
+bool detail::readTimeClaim(string_view key,
+                           const Json::Value& value,
+                           optional<int64_t>& exp,
+                           optional<int64_t>& nbf)
+{
+    if (key != "exp" && key != "nbf")
+    {
+        return true;
+    }
+    if (!value.isNumeric())
+    {
+        return false;
+    }
+    auto& claim = key == "exp" ? exp : nbf;
+    claim = value.isInt64() ? value.asInt64() : toNumericDate(value.asDouble());
+    return claim.has_value();
 }
 
 #define CHECK_AND_SET_S(key)                                              \
     if (payloadJson.isMember(#key))                                       \
     {                                                                     \
         assert(payloadJson[#key].isString());                             \
-        this->key##_ = make_shared<string>(payloadJson[#key].asString()); \
+        draft_.key##_ = payloadJson[#key].asString();                     \
     }
 
+JwtUtil::JwtUtil() = default;
+
+JwtUtil::~JwtUtil() = default;
+
 void JwtUtil::initAndStart(const Json::Value& config)
 {
+    lock_guard<mutex> lock(mutex_);
     if (config.isMember("secret"))
     {
         assert(config["secret"].isString());
@@ -92,7 +497,8 @@ void JwtUtil::initAndStart(const Json::Value& config)
         catch (const out_of_range& e)
         {
             LOG_ERROR << "Invalid algorithm: " << config["alg"].asString();
-            LOG_ERROR << "Supported algorithms: HS256, HS384, HS512.";
+            LOG_ERROR
+                << "Supported algorithms: HS256, HS384, HS512, EdDSA, ES256.";
             exit(1);
         }
     }
@@ -101,9 +507,157 @@ void JwtUtil::initAndStart(const Json::Value& config)
         alg_ = HS256;
     }
 
+    if (config.isMember("private_key"))
+    {
+        assert(config["private_key"].isString());
+        privateKeyPem_ = readFile(config["private_key"].asString());
+    }
+    if (config.isMember("public_key"))
+    {
+        assert(config["public_key"].isString());
+        publicKeyPem_ = readFile(config["public_key"].asString());
+    }
+
+    if (config.isMember("crypto"))
+    {
+        assert(config["crypto"].isString());
+        backend_ = cryptoBackendFromString(config["crypto"].asString());
+        if (!isAvailable(backend_))
+        {
+            LOG_WARN << "The crypto backend " << config["crypto"].asString()
+                     << " is not compiled in, use builtin.";
+            backend_ = CryptoBackend::Builtin;
+        }
+    }
+    if (isAsymmetric(alg_))
+    {
+#ifdef TL_JWT_USE_OPENSSL
+        try
+        {
+            updateKey();
+        }
+        catch (const invalid_argument& e)
+        {
+            LOG_ERROR << "Invalid key of " << toString(alg_) << ": "
+                      << e.what();
+            exit(1);
+        }
+#else
+        LOG_ERROR << toString(alg_)
+                  << " requires the OpenSSL crypto backend to be compiled in.";
+        exit(1);
+#endif
+    }
+    else
+    {
+        updateKey();
+    }
+
+    if (config.isMember("keys_file"))
+    {
+        assert(config["keys_file"].isString());
+        auto path = config["keys_file"].asString();
+        auto jwks = readFile(path);
+        try
+        {
+            draft_.keys_ = make_shared<const KeySet>(jwks, backend_);
+        }
+        catch (const invalid_argument& e)
+        {
+            LOG_ERROR << "Invalid key file " << path << ": " << e.what();
+            exit(1);
+        }
+        updateKey();
+        try
+        {
+            watcher_ = make_unique<KeyFileWatcher>(
+                path, std::move(jwks), [this, path](const string& content) {
+                    try
+                    {
+                        setKeys(content);
+                        LOG_INFO << "Reloaded the key file " << path;
+                    }
+                    catch (const invalid_argument& e)
+                    {
+                        LOG_ERROR << "Invalid key file " << path << ": "
+                                  << e.what() << ", keep the previous keys.";
+                    }
+                });
+        }
+        catch (const system_error& e)
+        {
+            LOG_WARN << "Can not watch the key file " << path << ": "
+                     << e.what() << ", it will not be reloaded.";
+        }
+    }
+
+    if (config.isMember("clock"))
+    {
+        assert(config["clock"].isString());
+        if (config["clock"].asString() == "coarse")
+        {
+            // the IO loops are created before the plugins are initialized
+            coarseClock_ = make_shared<CoarseClock>();
+            for (size_t i = 0; i < drogon::app().getThreadNum(); ++i)
+            {
+                coarseClock_->attach(drogon::app().getIOLoop(i));
+            }
+            coarseClock_->attach(drogon::app().getLoop());
+            draft_.clock_ = coarseClock_;
+        }
+        else if (config["clock"].asString() != "system")
+        {
+            LOG_WARN << "Invalid clock: " << config["clock"].asString()
+                     << ", use system.";
+        }
+    }
+    if (config.isMember("leeway"))
+    {
+        assert(config["leeway"].isInt64());
+        draft_.leeway_ = config["leeway"].asInt64();
+    }
+
+    if (config.isMember("policy") && !config["policy"].isNull())
+    {
+        try
+        {
+            draft_.policy_ = make_shared<const ClaimPolicy>(config["policy"]);
+        }
+        catch (const invalid_argument& e)
+        {
+            LOG_ERROR << "Invalid policy: " << e.what();
+            exit(1);
+        }
+    }
+
+    if (config.isMember("encode_cache"))
+    {
+        assert(config["encode_cache"].isNumeric());
+        auto refreshAfter = config["encode_cache"].asDouble();
+        if (!(refreshAfter >= 0 && refreshAfter <= 1))
+        {
+            LOG_ERROR << "Invalid encode_cache: " << refreshAfter
+                      << ", it must be in [0, 1].";
+            exit(1);
+        }
+        draft_.refreshAfter_ = refreshAfter;
+    }
+
+    if (config.isMember("zip"))
+    {
+        assert(config["zip"].isBool());
+        draft_.zip_ = config["zip"].asBool();
+    }
+    if (config.isMember("zip_threshold"))
+    {
+        assert(config["zip_threshold"].isUInt());
+        draft_.zipThreshold_ = config["zip_threshold"].asUInt();
+    }
+
     if (!config.isMember("payload"))
     {
         LOG_WARN << "Config file is not found payload.";
+        publish();
         return;
     }
     assert(config["payload"].isObject());
@@ -116,155 +670,813 @@ void JwtUtil::initAndStart(const Json::Value& config)
 
     if (payloadJson.isMember("exp"))
     {
-        assert(payloadJson["exp"].isInt());
-        auto exp = payloadJson["exp"].asInt();
+        assert(payloadJson["exp"].isInt64());
+        auto exp = payloadJson["exp"].asInt64();
         if (exp >= 0)
         {
-            this->exp_ = exp;
+            draft_.exp_ = exp;
         }
     }
     if (payloadJson.isMember("nbf"))
     {
-        assert(payloadJson["nbf"].isInt());
-        this->nbf_ = payloadJson["nbf"].asInt();
+        assert(payloadJson["nbf"].isInt64());
+        draft_.nbf_ = payloadJson["nbf"].asInt64();
     }
     if (payloadJson.isMember("jti"))
     {
         assert(payloadJson["jti"].isBool());
-        this->jti_ = payloadJson["jti"].asBool();
+        draft_.jti_ = payloadJson["jti"].asBool();
     }
+    publish();
 }
 
 #undef CHECK_AND_SET_S
 
 string JwtUtil::encode(const Json::Value& data)
 {
-    auto result = base64HeaderList.at(this->alg_);
+    auto config = snapshot();
+    if (config->refreshAfter_ > 0)
+    {
+        return config->encodeCached(data);
+    }
+    detail::Arena arena;
+    pmr::string payload(&arena);
+    config->serialize(data, payload);
+    return config->sign(payload);
+}
+
+void JwtUtil::Snapshot::serialize(const Json::Value& data,
+                                  pmr::string& payload) const
+{
+    payload += '{';
+    auto first = writeMembers(data, payload);
+    writeRegisteredClaims(payload, first);
+    payload += '}';
+}
 
-    Json::Value payload;
-    payload = data;
-    if (this->iss_ && *this->iss_ != "")
+bool JwtUtil::Snapshot::writeMembers(const Json::Value& data,
+                                     pmr::string& payload) const
+{
+    if (!data.isObject() && !data.isNull())
     {
-        payload["iss"] = *this->iss_;
+        throw invalid_argument("The payload must be an object");
     }
-    if (this->sub_ && *this->sub_ != "")
+
+    bool first = true;
+    for (auto it = data.begin(); it != data.end(); ++it)
     {
-        payload["sub"] = *this->sub_;
+        const char* end;
+        auto name = string_view(it.memberName(&end));
+        name = string_view(name.data(), end - name.data());
+        if (isOverridden(name))
+        {
+            continue;
+        }
+        if (!first)
+        {
+            payload += ',';
+        }
+        first = false;
+        json::writeString(payload, name);
+        payload += ':';
+        writeJson(payload, *it);
     }
-    if (this->aud_ && *this->aud_ != "")
+    return first;
+}
+
+string JwtUtil::Snapshot::encodeCached(const Json::Value& data) const
+{
+    detail::Arena arena;
+    pmr::string members(&arena);
+    writeMembers(data, members);
+    auto now = clock_->now();
+    auto it = tokens_.find(string_view(members));
+    if (it == tokens_.end())
     {
-        payload["aud"] = *this->aud_;
+        if (tokens_.size() >= maxCachedTokens)
+        {
+            // evict an arbitrary entry, a few services never reach here
+            tokens_.erase(tokens_.begin());
+        }
+        auto token = mint(members);
+        tokens_.emplace(string(members), CachedToken{token, now});
+        return token;
     }
-    // get current time
-    auto iat = time(nullptr);
-    payload["iat"] = iat;
-    if (this->exp_ >= 0)
+
+    auto& cached = it->second;
+    if (exp_ < 0 ||
+        now - cached.iat < static_cast<int64_t>(exp_ * refreshAfter_) ||
+        (cached.refreshing && now < cached.iat + exp_))
     {
-        payload["exp"] = this->exp_ + iat;
+        return cached.token;
     }
-    if (this->nbf_ >= 0)
+    auto* loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    // an expired token is never returned
+    if (!loop || now >= cached.iat + exp_)
     {
-        payload["nbf"] = this->nbf_ + iat;
+        cached.token = mint(members);
+        cached.iat = now;
+        cached.refreshing = false;
+        return cached.token;
     }
-    if (this->jti_)
+    cached.refreshing = true;
+    loop->queueInLoop(
+        [self = shared_from_this(), members = string(members)]() {
+            auto it = self->tokens_.find(members);
+            if (it == self->tokens_.end())
+            {
+                return;
+            }
+            it->second.iat = self->clock_->now();
+            it->second.token = self->mint(members);
+            it->second.refreshing = false;
+        });
+    return cached.token;
+}
+
+string JwtUtil::Snapshot::mint(string_view members) const
+{
+    detail::Arena arena;
+    pmr::string payload(&arena);
+    payload.reserve(members.size() + 128);
+    payload += '{';
+    payload += members;
+    writeRegisteredClaims(payload, members.empty());
+    payload += '}';
+    return sign(payload);
+}
+
+pair<Result, shared_ptr<Json::Value>> JwtUtil::decode(const string& token)
+{
+    optional<int64_t> exp, nbf;
+    return decodeJson(*snapshot(), token, exp, nbf);
+}
+
+pair<Result, shared_ptr<Json::Value>> JwtUtil::decodeJson(
+    const Snapshot& config,
+    string_view token,
+    optional<int64_t>& exp,
+    optional<int64_t>& nbf)
+{
+    detail::Arena arena;
+    pmr::string buffer(&arena);
+    string_view payloadStr;
+    auto result = config.verify(token, buffer, payloadStr);
+    if (result != Ok)
     {
-        payload["jti"] = getUuid();
+        return {result, nullptr};
     }
 
-    Json::StreamWriterBuilder builder;
-    builder["indentation"] = "";
-    auto payloadStr = Json::writeString(builder, payload);
+    thread_local auto reader =
+        unique_ptr<Json::CharReader>(Json::CharReaderBuilder().newCharReader());
+    auto payloadValue = make_shared<Json::Value>();
 
-    auto payloadBase64 = drogon::utils::base64Encode(payloadStr, true, false);
-    result += '.' + payloadBase64;
+    // string to Json::Value, which is stricter than the scanner, e.g. about
+    // the escape sequences
+    if (!reader->parse(payloadStr.data(),
+                       payloadStr.data() + payloadStr.size(),
+                       payloadValue.get(),
+                       nullptr) ||
+        !payloadValue->isObject())
+    {
+        return {InvalidPayload, nullptr};
+    }
 
-    auto signature = hmacEncode(this->secret_, result, this->alg_);
+    // the claims are read from the tree, instead of scanning the payload again
+    for (string_view key : {"exp", "nbf"})
+    {
+        auto* claim = payloadValue->find(key.data(), key.data() + key.size());
+        if (claim && !detail::readTimeClaim(key, *claim, exp, nbf))
+        {
+            return {InvalidPayload, nullptr};
+        }
+    }
+    result = config.validateTime(exp, nbf);
+    if (result == Ok && config.policy_)
+    {
+        result = config.policy_->check(*payloadValue);
+    }
+    if (result != Ok)
+    {
+        return {result, nullptr};
+    }
 
-    result += '.' + signature;
+    Json::Value temp;
+    if (exp)
+    {
+        payloadValue->removeMember("exp", &temp);
+    }
+    if (nbf)
+    {
+        payloadValue->removeMember("nbf", &temp);
+    }
+    payloadValue->removeMember("iat", &temp);
+
+    return {Ok, payloadValue};
+}
+
+pair<Result, string> JwtUtil::refresh(string_view token)
+{
+    auto config = snapshot();
+    detail::Arena arena;
+    pmr::string buffer(&arena);
+    string_view payload;
+    auto result = config->verify(token, buffer, payload);
+    if (result != Ok)
+    {
+        return {result, {}};
+    }
 
+    pmr::string newPayload(1, '{', &arena);
+    newPayload.reserve(payload.size() + 128);
+    optional<int64_t> exp, nbf;
+    optional<ClaimPolicy::Matcher> matcher;
+    if (config->policy_)
+    {
+        matcher.emplace(*config->policy_);
+    }
+    bool first = true;
+    json::Scanner scanner(payload);
+    auto ok = scanner.forEachMember([&](auto key, json::Scanner& s) {
+        if (matcher)
+        {
+            matcher->onMember(key, s);
+        }
+        if (!detail::readTimeClaim(key, s, exp, nbf))
+        {
+            return false;
+        }
+        s.skipSpaces();
+        auto begin = s.position();
+        if (!s.skipValue())
+        {
+            return false;
+        }
+        if (config->isOverridden(key))
+        {
+            return true;
+        }
+        // copy the value as it is
+        if (!first)
+        {
+            newPayload += ',';
+        }
+        first = false;
+        json::writeString(newPayload, key);
+        newPayload += ':';
+        newPayload.append(begin, s.position() - begin);
+        return true;
+    });
+    if (!ok || !scanner.atEnd())
+    {
+        return {InvalidPayload, {}};
+    }
+
+    result = config->validateTime(exp, nbf);
+    if (result == Ok && matcher)
+    {
+        result = matcher->finish();
+    }
+    if (result != Ok)
+    {
+        return {result, {}};
+    }
+
+    config->writeRegisteredClaims(newPayload, first);
+    newPayload += '}';
+    return {Ok, config->sign(newPayload)};
+}
+
+string JwtUtil::Snapshot::sign(pmr::string& payload) const
+{
+    const auto& header = compress(payload);
+    // the exact size of the token is known, so it is written in place
+    string result(tokenLength(header, payload.size()), '\0');
+    signTo(header, payload, result.data());
     return result;
 }
 
-pair<Result, shared_ptr<Json::Value>> JwtUtil::decode(const string& token)
+const string& JwtUtil::Snapshot::compress(pmr::string& payload) const
 {
-    auto parts = drogon::utils::splitString(token, ".");
-    if (parts.size() != 3)
+    if (!zip_ || payload.size() <= zipThreshold_)
     {
-        return {InvalidToken, nullptr};
+        return header_;
     }
+    pmr::string compressed(payload.get_allocator());
+    if (!deflatePayload(payload, compressed) || compressed.size() >= payload.size())
+    {
+        return header_;
+    }
+    payload.swap(compressed);
+    return zipHeader_;
+}
 
-    auto header = parts[0];
-    auto payload = parts[1];
-    auto signature = parts[2];
+size_t JwtUtil::Snapshot::tokenLength(const string& header,
+                                     size_t payloadSize) const
+{
+    return header.size() + 1 + base64url::encodedLength(payloadSize) + 1 +
+           base64url::encodedLength(signatureSize());
+}
+
+void JwtUtil::Snapshot::signTo(const string& header,
+                               string_view payload,
+                               char* out) const
+{
+    auto* p = out;
+    memcpy(p, header.data(), header.size());
+    p += header.size();
+    *p++ = '.';
+    base64url::encode(payload.data(), payload.size(), p);
+    p += base64url::encodedLength(payload.size());
+
+    unsigned char digest[maxDigestSize];
+    auto size = signMessage(string_view(out, p - out), digest);
+    *p++ = '.';
+    base64url::encode(digest, size, p);
+}
+
+Result JwtUtil::Snapshot::verify(string_view token,
+                                 pmr::string& buffer,
+                                 string_view& payload,
+                                 BatchState* batch) const
+{
+    auto dot1 = token.find('.');
+    auto dot2 = dot1 == string_view::npos ? dot1 : token.find('.', dot1 + 1);
+    if (dot2 == string_view::npos ||
+        token.find('.', dot2 + 1) != string_view::npos || dot1 == 0 ||
+        dot2 == dot1 + 1 || dot2 + 1 == token.size())
+    {
+        return InvalidToken;
+    }
 
-    Json::CharReaderBuilder builder;
-    auto reader = unique_ptr<Json::CharReader>(builder.newCharReader());
+    auto header = token.substr(0, dot1);
+    auto encodedPayload = token.substr(dot1 + 1, dot2 - dot1 - 1);
+    auto signature = token.substr(dot2 + 1);
 
     // check header
-    if (header != base64HeaderList.at(alg_))
+    bool compressed = false;
+    const auto* hmac = &key_;
+    if (header == zipHeader_)
     {
-        auto headerStr = base64Decode(header);
-        // string to Json::Value
-        Json::Value headerValue;
-        if (!reader->parse(headerStr.data(),
-                           headerStr.data() + headerStr.size(),
-                           &headerValue,
-                           nullptr))
+        compressed = true;
+    }
+    else if (header != header_)
+    {
+        auto result = Ok;
+        if (batch && header == batch->header)
+        {
+            result = batch->headerError;
+            hmac = batch->headerKey;
+            compressed = batch->compressed;
+        }
+        else
         {
-            return {InvalidHeader, nullptr};
+            result = checkHeader(header, hmac, compressed);
+            if (batch)
+            {
+                batch->header = header;
+                batch->headerError = result;
+                batch->headerKey = hmac;
+                batch->compressed = compressed;
+            }
         }
-        if (!headerValue.isMember("alg") || headerValue["alg"] != alg_)
+        if (result != Ok)
         {
-            return {InvalidAlgorithm, nullptr};
+            return result;
         }
     }
 
-    if (signature !=
-        hmacEncode(this->secret_, header + '.' + payload, this->alg_))
+    if (!verifySignature(token.substr(0, dot2), signature, *hmac, batch))
     {
-        return {InvalidSignature, nullptr};
+        return InvalidSignature;
+    }
+    if (header != header_ && header != zipHeader_)
+    {
+        cacheHeader(header);
     }
 
     // decode payload
-    auto payloadStr = base64Decode(payload);
-    auto payloadValue = make_shared<Json::Value>();
+    buffer.resize(base64url::decodedLength(encodedPayload.size()));
+    auto length = base64url::decode(encodedPayload, buffer.data());
+    if (length < 0)
+    {
+        return InvalidPayload;
+    }
+    buffer.resize(length);
+    payload = buffer;
 
-    // string to Json::Value
-    reader->parse(payloadStr.data(),
-                  payloadStr.data() + payloadStr.size(),
-                  payloadValue.get(),
-                  nullptr);
+    if (compressed)
+    {
+        auto inflated = inflatePayload(payload);
+        if (!inflated)
+        {
+            return InvalidPayload;
+        }
+        payload = *inflated;
+    }
+    return Ok;
+}
 
-    if (payloadValue->isMember("exp") && (*payloadValue)["exp"].isInt())
+Result JwtUtil::Snapshot::checkHeader(string_view header,
+                                      const HmacKey*& hmac,
+                                      bool& compressed) const
+{
+    const auto& info = parseHeader(header);
+    if (info.error != Ok)
     {
-        auto exp = (*payloadValue)["exp"].asInt();
-        auto now = time(nullptr);
-        if (exp < now)
+        return info.error;
+    }
+    // the tokens of the other keys of the set
+    auto algorithm = alg_;
+    if (keys_ && !info.kid.empty())
+    {
+        const auto* key = keys_->find(info.kid);
+        if (!key)
         {
-            return {ExpiredToken, nullptr};
+            return InvalidSignature;
         }
-        Json::Value temp;
-        payloadValue->removeMember("exp", &temp);
+        algorithm = key->alg;
+        hmac = &key->hmac;
     }
+    if (info.alg != toString(algorithm))
+    {
+        return InvalidAlgorithm;
+    }
+    if (info.invalidZip)
+    {
+        return InvalidHeader;
+    }
+    compressed = info.compressed;
+    return Ok;
+}
 
-    if (payloadValue->isMember("nbf") && (*payloadValue)["nbf"].isInt())
+vector<Result> JwtUtil::verifyBatch(span<const string_view> tokens)
+{
+    auto config = snapshot();
+    vector<Result> results;
+    results.reserve(tokens.size());
+    // one arena for the whole batch, it is released after every token
+    detail::Arena arena;
+    Snapshot::BatchState batch;
+    optional<ClaimPolicy::Matcher> matcher;
+    if (config->policy_)
+    {
+        matcher.emplace(*config->policy_);
+    }
+    for (auto token : tokens)
     {
-        auto nbf = (*payloadValue)["nbf"].asInt();
-        auto now = time(nullptr);
-        if (nbf > now)
+        auto result = Ok;
         {
-            return {InvalidNotBefore, nullptr};
+            pmr::string buffer(&arena);
+            string_view payload;
+            result = config->verify(token, buffer, payload, &batch);
+            if (result == Ok)
+            {
+                optional<int64_t> exp, nbf;
+                if (matcher)
+                {
+                    matcher->reset();
+                }
+                auto ok = scanClaims(
+                    payload, exp, nbf, matcher ? &*matcher : nullptr);
+                result = ok ? config->validateTime(exp, nbf) : InvalidPayload;
+                if (result == Ok && matcher)
+                {
+                    result = matcher->finish();
+                }
+            }
         }
-        Json::Value temp;
-        payloadValue->removeMember("nbf", &temp);
+        // the deallocation of a monotonic arena is a no-op, so the buffer
+        // of the next token reuses the stack block only after this
+        arena.release();
+        results.push_back(result);
     }
+    return results;
+}
 
-    Json::Value temp;
-    payloadValue->removeMember("iat", &temp);
+size_t JwtUtil::Snapshot::signMessage(string_view message,
+                                     unsigned char* out) const
+{
+#ifdef TL_JWT_USE_OPENSSL
+    if (isAsymmetric(alg_))
+    {
+        if (!asymmetricKey_ || !asymmetricKey_->canSign())
+        {
+            throw runtime_error("No private key to sign");
+        }
+        asymmetricKey_->sign(message, out);
+        return AsymmetricKey::signatureSize;
+    }
+#endif
+    return hmacSign(key_, message, out);
+}
 
-    return {Ok, payloadValue};
+bool JwtUtil::Snapshot::verifySignature(
+    string_view message,
+    string_view signature,
+    const HmacKey& hmac,
+    [[maybe_unused]] BatchState* batch) const
+{
+#ifdef TL_JWT_USE_OPENSSL
+    if (isAsymmetric(alg_))
+    {
+        unsigned char raw[AsymmetricKey::signatureSize + 3];
+        if (!asymmetricKey_ ||
+            signature.size() !=
+                base64url::encodedLength(AsymmetricKey::signatureSize) ||
+            base64url::decode(signature, raw) !=
+                static_cast<ptrdiff_t>(AsymmetricKey::signatureSize))
+        {
+            return false;
+        }
+        string_view rawSignature(reinterpret_cast<const char*>(raw),
+                                 AsymmetricKey::signatureSize);
+        if (!batch)
+        {
+            return asymmetricKey_->verify(message, rawSignature);
+        }
+        if (!batch->verifier)
+        {
+            batch->verifier.emplace(*asymmetricKey_);
+        }
+        return batch->verifier->verify(message, rawSignature);
+    }
+#endif
+    unsigned char digest[maxDigestSize];
+    size_t size;
+#ifdef TL_JWT_USE_OPENSSL
+    const auto* openssl = get_if<OpenSslHmac>(&hmac);
+    if (batch && openssl)
+    {
+        // the keys of a set are mixed rarely in a batch
+        if (batch->macKey != openssl)
+        {
+            batch->macKey = openssl;
+            batch->macContext = openssl->threadContext();
+        }
+        openssl->sign(batch->macContext, message, digest);
+        size = openssl->digestSize;
+    }
+    else
+#endif
+    {
+        size = hmacSign(hmac, message, digest);
+    }
+    char expected[base64url::encodedLength(maxDigestSize)];
+    base64url::encode(digest, size, expected);
+    return signature == string_view(expected, base64url::encodedLength(size));
+}
+
+size_t JwtUtil::Snapshot::signatureSize() const
+{
+#ifdef TL_JWT_USE_OPENSSL
+    if (isAsymmetric(alg_))
+    {
+        return AsymmetricKey::signatureSize;
+    }
+#endif
+    return digestSize(key_);
+}
+
+Result JwtUtil::Snapshot::validateTime(optional<int64_t> exp,
+                                      optional<int64_t> nbf) const
+{
+    auto now = clock_->now();
+    if (exp && *exp < now - leeway_)
+    {
+        return ExpiredToken;
+    }
+    if (nbf && *nbf > now + leeway_)
+    {
+        return InvalidNotBefore;
+    }
+    return Ok;
+}
+
+bool JwtUtil::Snapshot::isOverridden(string_view claim) const
+{
+    if (claim == "iat")
+    {
+        return true;
+    }
+    if (claim == "iss")
+    {
+        return !iss_.empty();
+    }
+    if (claim == "sub")
+    {
+        return !sub_.empty();
+    }
+    if (claim == "aud")
+    {
+        return !aud_.empty();
+    }
+    if (claim == "exp")
+    {
+        return this->exp_ >= 0;
+    }
+    if (claim == "nbf")
+    {
+        return this->nbf_ >= 0;
+    }
+    if (claim == "jti")
+    {
+        return this->jti_;
+    }
+    return false;
+}
+
+void JwtUtil::Snapshot::writeRegisteredClaims(pmr::string& payload,
+                                              bool first) const
+{
+    auto writeKey = [&payload, &first](string_view key) {
+        if (!first)
+        {
+            payload += ',';
+        }
+        first = false;
+        json::writeString(payload, key);
+        payload += ':';
+    };
+    if (!staticClaims_.empty())
+    {
+        if (!first)
+        {
+            payload += ',';
+        }
+        first = false;
+        payload += staticClaims_;
+    }
+    // get current time
+    auto iat = clock_->now();
+    writeKey("iat");
+    json::writeInt(payload, iat);
+    if (this->exp_ >= 0)
+    {
+        writeKey("exp");
+        json::writeInt(payload, this->exp_ + iat);
+    }
+    if (this->nbf_ >= 0)
+    {
+        writeKey("nbf");
+        json::writeInt(payload, this->nbf_ + iat);
+    }
+    if (this->jti_)
+    {
+        writeKey("jti");
+        json::writeString(payload, getUuid());
+    }
+}
+
+shared_ptr<const JwtUtil::Snapshot> JwtUtil::snapshot() const
+{
+    struct ThreadSnapshot
+    {
+        uint64_t generation{0};
+        shared_ptr<const Snapshot> snapshot;
+    };
+    auto generation = generation_.load(memory_order_acquire);
+    auto& cached = detail::ThreadCache<ThreadSnapshot>::get(
+        owner_, []() { return ThreadSnapshot{}; });
+    if (cached.snapshot && cached.generation == generation)
+    {
+        return cached.snapshot;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    // draft_ may be published again after the generation is loaded
+    cached.generation = generation_.load(memory_order_relaxed);
+    cached.snapshot = make_shared<const Snapshot>(draft_);
+    return cached.snapshot;
+}
+
+void JwtUtil::publish()
+{
+    if (draft_.keys_)
+    {
+        draft_.header_ = draft_.keys_->signingKey().header;
+        draft_.zipHeader_ = draft_.keys_->signingKey().zipHeader;
+    }
+    else
+    {
+        draft_.header_ = base64HeaderList.at(draft_.alg_);
+        draft_.zipHeader_ = base64ZipHeaderList.at(draft_.alg_);
+    }
+    auto& claims = draft_.staticClaims_;
+    claims.clear();
+    for (auto [key, value] : {pair{"iss", &draft_.iss_},
+                              pair{"sub", &draft_.sub_},
+                              pair{"aud", &draft_.aud_}})
+    {
+        if (value->empty())
+        {
+            continue;
+        }
+        if (!claims.empty())
+        {
+            claims += ',';
+        }
+        json::writeString(claims, key);
+        claims += ':';
+        json::writeString(claims, *value);
+    }
+    generation_.fetch_add(1, memory_order_release);
+}
+
+HmacKey tl::jwt::makeHmacKey(Algorithm alg,
+                             [[maybe_unused]] CryptoBackend backend,
+                             string_view secret)
+{
+#ifdef TL_JWT_USE_OPENSSL
+    if (backend == CryptoBackend::OpenSSL)
+    {
+        switch (alg)
+        {
+            case HS384:
+                return OpenSslHmac("SHA384", 48, secret);
+            case HS512:
+                return OpenSslHmac("SHA512", 64, secret);
+            default:
+                return OpenSslHmac("SHA256", 32, secret);
+        }
+    }
+#endif
+    switch (alg)
+    {
+        case HS384:
+            return Hmac<sha2::Sha384>(secret);
+        case HS512:
+            return Hmac<sha2::Sha512>(secret);
+        default:
+            return Hmac<sha2::Sha256>(secret);
+    }
+}
+
+void JwtUtil::setKeys(string_view jwks)
+{
+    CryptoBackend backend;
+    {
+        lock_guard<mutex> lock(mutex_);
+        backend = backend_;
+    }
+    // keyed before locking, the requests only wait for the swap
+    shared_ptr<const KeySet> keys;
+    if (!jwks.empty())
+    {
+        keys = make_shared<const KeySet>(jwks, backend);
+    }
+    lock_guard<mutex> lock(mutex_);
+    draft_.keys_ = std::move(keys);
+    updateKey();
+    publish();
+}
+
+void JwtUtil::updateKey()
+{
+    if (draft_.keys_)
+    {
+        // keyed again after the backend is changed, or if it is changed
+        // while setKeys() is keying the set without the lock
+        if (draft_.keys_->backend() != backend_)
+        {
+            draft_.keys_ =
+                make_shared<const KeySet>(draft_.keys_->jwks(), backend_);
+        }
+        const auto& key = draft_.keys_->signingKey();
+        draft_.alg_ = key.alg;
+        assignKey(draft_.key_, key.hmac);
+        return;
+    }
+    draft_.alg_ = alg_;
+#ifdef TL_JWT_USE_OPENSSL
+    if (isAsymmetric(alg_))
+    {
+        // the keys may be set after the algorithm
+        if (privateKeyPem_.empty() && publicKeyPem_.empty())
+        {
+            draft_.asymmetricKey_.reset();
+            return;
+        }
+        draft_.asymmetricKey_ = make_shared<const AsymmetricKey>(
+            alg_ == EdDSA ? AsymmetricKey::Ed25519 : AsymmetricKey::P256,
+            privateKeyPem_,
+            publicKeyPem_);
+        return;
+    }
+#else
+    if (isAsymmetric(alg_))
+    {
+        throw invalid_argument(toString(alg_) + " requires OpenSSL");
+    }
+#endif
+    assignKey(draft_.key_, makeHmacKey(alg_, backend_, secret_));
 }
 
 void JwtUtil::shutdown()
 {
+    watcher_.reset();
+    if (coarseClock_)
+    {
+        coarseClock_->detach();
+    }
 }
@@ -4,7 +4,7 @@
  *
  * @author tanglong3bf
  * @date 2025-05-26
- * @version v0.2.0
+ * @version v0.3.0
  *
  * @copyright Copyright (c) 2024 - 2025 tanglong3bf
  * @license MIT License
@@ -12,52 +12,32 @@
 
 #pragma once
 
+#include <drogon/HttpRequest.h>
 #include <drogon/plugins/Plugin.h>
+#include <trantor/utils/MsgBuffer.h>
+#include <atomic>
+#include <ctime>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "AsymmetricKey.h"
+#include "ClaimPolicy.h"
+#include "Claims.h"
+#include "Clock.h"
+#include "Hmac.h"
+#include "OpenSslHmac.h"
+#include "Result.h"
+#include "WebSocketSession.h"
+#include "detail/ThreadCache.h"
 
 namespace tl::jwt
 {
 
-/// The result of decoding a jwt token.
-enum Result
-{
-    Ok = 0,            ///< parsing success
-    InvalidToken,      ///< token format is not correct
-    InvalidSignature,  ///< signature is not correct
-    InvalidHeader,     ///< header is not correct
-    InvalidAlgorithm,  ///< not supported algorithm
-    InvalidPayload,    ///< payload is not correct
-    InvalidNotBefore,  ///< token is not valid before nbf
-    ExpiredToken,      ///< token is expired
-};
-
-/**
- * @date 2025-05-26
- * @since v0.0.1
- */
-inline std::string toString(Result result)
-{
-    switch (result)
-    {
-        case Ok:
-            return "Ok";
-        case InvalidToken:
-            return "InvalidToken";
-        case InvalidSignature:
-            return "InvalidSignature";
-        case InvalidHeader:
-            return "InvalidHeader";
-        case InvalidAlgorithm:
-            return "InvalidAlgorithm";
-        case InvalidPayload:
-            return "InvalidPayload";
-        case InvalidNotBefore:
-            return "InvalidNotBefore";
-        case ExpiredToken:
-            return "ExpiredToken";
-    }
-    return "Unknown";
-}
-
 /**
  * @brief The supported algorithms for encoding and decoding jwt.
  *
@@ -68,9 +48,23 @@ enum Algorithm
 {
     HS256,
     HS384,
-    HS512
+    HS512,
+    EdDSA,  ///< Ed25519, requires TL_JWT_USE_OPENSSL, since v0.3.0
+    ES256,  ///< ECDSA P-256, requires TL_JWT_USE_OPENSSL, since v0.3.0
 };
 
+/**
+ * @brief Whether the algorithm signs by a private key and verifies by a
+ * public key, instead of a shared secret.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+inline bool isAsymmetric(Algorithm alg)
+{
+    return alg == EdDSA || alg == ES256;
+}
+
 /**
  * @brief
  *
@@ -91,23 +85,274 @@ inline Algorithm fromString(const std::string& str)
     {
         return HS512;
     }
+    else if (str == "EdDSA" || str == "Ed25519")
+    {
+        return EdDSA;
+    }
+    else if (str == "ES256")
+    {
+        return ES256;
+    }
     LOG_ERROR << "Invalid algorithm: " << str;
     throw std::invalid_argument("Invalid algorithm");
 }
 
+/**
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+inline std::string toString(Algorithm alg)
+{
+    switch (alg)
+    {
+        case HS256:
+            return "HS256";
+        case HS384:
+            return "HS384";
+        case HS512:
+            return "HS512";
+        case EdDSA:
+            return "EdDSA";
+        case ES256:
+            return "ES256";
+    }
+    return "Unknown";
+}
+
 const std::unordered_map<Algorithm, std::string> base64HeaderList{
     {HS256, "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9"},
     {HS384, "eyJhbGciOiJIUzM4NCIsInR5cCI6IkpXVCJ9"},
     {HS512, "eyJhbGciOiJIUzUxMiIsInR5cCI6IkpXVCJ9"},
+    {EdDSA, "eyJhbGciOiJFZERTQSIsInR5cCI6IkpXVCJ9"},
+    {ES256, "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCJ9"},
 };
 
-class JwtUtil : public drogon::Plugin<JwtUtil>
+/// The headers with `"zip":"DEF"`, whose payloads are compressed by DEFLATE.
+const std::unordered_map<Algorithm, std::string> base64ZipHeaderList{
+    {HS256, "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCIsInppcCI6IkRFRiJ9"},
+    {HS384, "eyJhbGciOiJIUzM4NCIsInR5cCI6IkpXVCIsInppcCI6IkRFRiJ9"},
+    {HS512, "eyJhbGciOiJIUzUxMiIsInR5cCI6IkpXVCIsInppcCI6IkRFRiJ9"},
+    {EdDSA, "eyJhbGciOiJFZERTQSIsInR5cCI6IkpXVCIsInppcCI6IkRFRiJ9"},
+    {ES256, "eyJhbGciOiJFUzI1NiIsInR5cCI6IkpXVCIsInppcCI6IkRFRiJ9"},
+};
+
+/**
+ * @brief The implementations of SHA-2 and HMAC.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+enum class CryptoBackend
+{
+    Builtin,  ///< sha2.h, always available
+    OpenSSL,  ///< libcrypto, available if TL_JWT_USE_OPENSSL is defined
+};
+
+/**
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+inline CryptoBackend cryptoBackendFromString(const std::string& str)
+{
+    if (str == "builtin")
+    {
+        return CryptoBackend::Builtin;
+    }
+    else if (str == "openssl")
+    {
+        return CryptoBackend::OpenSSL;
+    }
+    LOG_ERROR << "Invalid crypto backend: " << str;
+    throw std::invalid_argument("Invalid crypto backend");
+}
+
+/// Whether the backend is compiled in.
+inline bool isAvailable([[maybe_unused]] CryptoBackend backend)
+{
+#ifdef TL_JWT_USE_OPENSSL
+    return true;
+#else
+    return backend == CryptoBackend::Builtin;
+#endif
+}
+
+using HmacKey = std::variant<Hmac<sha2::Sha256>,
+                             Hmac<sha2::Sha384>,
+                             Hmac<sha2::Sha512>
+#ifdef TL_JWT_USE_OPENSSL
+                             ,
+                             OpenSslHmac
+#endif
+                             >;
+
+/**
+ * @brief Key the HMAC of the algorithm by the backend.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+HmacKey makeHmacKey(Algorithm alg,
+                    CryptoBackend backend,
+                    std::string_view secret);
+
+class KeySet;
+class KeyFileWatcher;
+
+namespace detail
+{
+/**
+ * @brief A monotonic arena whose first block lives on the stack. All the
+ * temporaries of an encode() or a decode() are allocated from it, so malloc is
+ * never called for them unless the token is unusually large.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class Arena : public std::pmr::monotonic_buffer_resource
+{
+  public:
+    Arena() : std::pmr::monotonic_buffer_resource(buffer_, sizeof(buffer_))
+    {
+    }
+
+  private:
+    alignas(std::max_align_t) std::byte buffer_[4096];
+};
+
+/**
+ * @brief An incremental HMAC, which owns a copy of the key.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class HmacStream
+{
+  public:
+    explicit HmacStream(const HmacKey& key);
+
+    void update(std::string_view data);
+
+    /// Write the digest to out and return its size, it is called once.
+    size_t finish(unsigned char* out);
+
+  private:
+    using Context = std::variant<sha2::Sha256,
+                                 sha2::Sha384,
+                                 sha2::Sha512
+#ifdef TL_JWT_USE_OPENSSL
+                                 ,
+                                 OpenSslHmac::Context
+#endif
+                                 >;
+
+    HmacKey key_;
+    Context context_;
+};
+
+/**
+ * @brief Read a member of a payload into exp or nbf if it is one of them,
+ * without consuming it. A NumericDate may have a fraction (RFC 7519 §2),
+ * which is truncated.
+ *
+ * @return false if it is "exp" or "nbf" but not a number.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+bool readTimeClaim(std::string_view key,
+                   json::Scanner value,
+                   std::optional<int64_t>& exp,
+                   std::optional<int64_t>& nbf);
+
+/// The same as above, for a claim which is already parsed, e.g. from CBOR.
+bool readTimeClaim(std::string_view key,
+                   const Json::Value& value,
+                   std::optional<int64_t>& exp,
+                   std::optional<int64_t>& nbf);
+}  // namespace detail
+
+/**
+ * @brief Sign a detached payload (RFC 7797) chunk by chunk, which is created
+ * by JwtUtil::signDetached(). The payload is signed as it is, without base64
+ * encoding, and it is not buffered.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class DetachedSigner
+{
+  public:
+    /// Feed the next chunk of the payload.
+    void update(std::string_view chunk)
+    {
+        stream_.update(chunk);
+    }
+
+    /// The token "header..signature", it is called once.
+    std::string finish();
+
+  private:
+    friend class JwtUtil;
+
+    DetachedSigner(std::string header, const HmacKey& key);
+
+    std::string header_;
+    detail::HmacStream stream_;
+};
+
+/**
+ * @brief Verify a detached payload (RFC 7797) chunk by chunk, which is
+ * created by JwtUtil::verifyDetached(). The header is checked when it is
+ * created, and the signature when it is finished.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class DetachedVerifier
 {
   public:
-    JwtUtil()
+    /// Feed the next chunk of the payload.
+    void update(std::string_view chunk)
+    {
+        if (stream_)
+        {
+            stream_->update(chunk);
+        }
+    }
+
+    /**
+     * @brief Check the signature, it is called once.
+     *
+     * @retval Ok The payload is signed by the token.
+     * @retval InvalidToken The token is not "header..signature".
+     * @retval InvalidHeader The header is not JSON, or it does not have
+     * `"b64":false` and `"crit":["b64"]`.
+     * @retval InvalidAlgorithm The algorithm is not the configured one, or it
+     * is not HMAC.
+     * @retval InvalidSignature The signature does not match.
+     */
+    Result finish();
+
+  private:
+    friend class JwtUtil;
+
+    explicit DetachedVerifier(Result error) : error_(error)
     {
     }
 
+    DetachedVerifier(std::string_view signature, const HmacKey& key);
+
+    Result error_{Ok};
+    std::string signature_;
+    std::optional<detail::HmacStream> stream_;
+};
+
+class JwtUtil : public drogon::Plugin<JwtUtil>
+{
+  public:
+    JwtUtil();
+    ~JwtUtil();
+
     /**
      * @date 2025-05-26
      * @since v0.0.1
@@ -137,7 +382,165 @@ class JwtUtil : public drogon::Plugin<JwtUtil>
      */
     void setSecret(const std::string& secret)
     {
+        std::lock_guard<std::mutex> lock(mutex_);
         secret_ = secret;
+        updateKey();
+        publish();
+    }
+
+    /**
+     * @brief Set the PEM encoded keys of EdDSA or ES256, which are parsed
+     * once here. A verifying service only needs the public key. This will
+     * overwrite the "private_key" and "public_key" settings in the config
+     * file.
+     *
+     * @param privateKeyPem The private key, or empty.
+     * @param publicKeyPem The public key, or empty if it is derived from the
+     * private key.
+     *
+     * @throw std::invalid_argument If the keys can not be parsed, or they do
+     * not match the algorithm.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setPemKeys(const std::string& privateKeyPem,
+                    const std::string& publicKeyPem = "")
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        privateKeyPem_ = privateKeyPem;
+        publicKeyPem_ = publicKeyPem;
+        updateKey();
+        publish();
+    }
+
+    /**
+     * @brief Set the HMAC keys from a JWK Set, see KeySet. The first key
+     * signs the new tokens with its "kid" in the header, and the tokens are
+     * verified by the key of their "kid". The keys take precedence over the
+     * secret and the "alg" setting, until they are removed. This will
+     * overwrite the keys of the "keys_file" setting, until the file is
+     * changed again.
+     *
+     * @param jwks The JSON text of the set, or empty to remove the keys.
+     *
+     * @throw std::invalid_argument If the set is malformed.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setKeys(std::string_view jwks);
+
+    /**
+     * @brief Select the implementation of SHA-2 and HMAC. This will overwrite
+     * the "crypto" setting in the config file. The secret and the keys of
+     * setKeys() are keyed again with the backend.
+     *
+     * @throw std::invalid_argument If the backend is not compiled in.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setCryptoBackend(CryptoBackend backend)
+    {
+        if (!isAvailable(backend))
+        {
+            throw std::invalid_argument("The crypto backend is not available");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        backend_ = backend;
+        updateKey();
+        publish();
+    }
+
+    /**
+     * @brief Set the claim policy, which is checked by every decoding after
+     * the signature and the time claims. This will overwrite the "policy"
+     * setting in the config file.
+     *
+     * @param policy The config of the policy, see ClaimPolicy. A null value
+     * removes the policy.
+     *
+     * @throw std::invalid_argument If the policy is malformed.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setPolicy(const Json::Value& policy)
+    {
+        std::shared_ptr<const ClaimPolicy> compiled;
+        if (!policy.isNull())
+        {
+            compiled = std::make_shared<const ClaimPolicy>(policy);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        draft_.policy_ = std::move(compiled);
+        publish();
+    }
+
+    /**
+     * @brief Set the source of the current time, which is used by encoding
+     * and checking the time claims. This will overwrite the "clock" setting
+     * in the config file.
+     *
+     * @param clock e.g. a ManualClock for the tests.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setClock(std::shared_ptr<const Clock> clock)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        draft_.clock_ = std::move(clock);
+        publish();
+    }
+
+    /**
+     * @brief Accept the tokens which are expired or not yet valid by up to
+     * `seconds`, for the clock skew between the services. This will overwrite
+     * the "leeway" setting in the config file.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setLeeway(int64_t seconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        draft_.leeway_ = seconds;
+        publish();
+    }
+
+    /**
+     * @brief Reuse the tokens of the same payloads, e.g. the identity of a
+     * service which is sent with every outbound call. encode(const
+     * Json::Value&) returns the token which is minted for the same payload
+     * before, until `refreshAfter` of its lifetime has elapsed. Then the
+     * token is minted again on the IO loop of the caller after the current
+     * task, and the caller still gets the previous token, which is valid
+     * yet. The threads without a loop mint it again at once. The reused
+     * tokens have the same "jti". This will overwrite the "encode_cache"
+     * setting in the config file.
+     *
+     * Every thread caches up to 64 payloads, and the caches are cleared
+     * when the configuration is changed.
+     *
+     * @param refreshAfter The part of the lifetime in (0, 1], or 0 to
+     * disable the cache.
+     *
+     * @throw std::invalid_argument If refreshAfter is out of range.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    void setEncodeCache(double refreshAfter)
+    {
+        if (!(refreshAfter >= 0 && refreshAfter <= 1))
+        {
+            throw std::invalid_argument("refreshAfter must be in [0, 1]");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        draft_.refreshAfter_ = refreshAfter;
+        publish();
     }
 
     /**
@@ -172,19 +575,603 @@ class JwtUtil : public drogon::Plugin<JwtUtil>
     std::pair<Result, std::shared_ptr<Json::Value>> decode(
         const std::string& token);
 
+    /**
+     * @brief decode the bearer token of the "Authorization" header once per
+     * request. The result is kept in the attributes of the request, so the
+     * filters and the handler which call it again get the same payload back
+     * without verifying the token again.
+     *
+     * @param req The request.
+     *
+     * @return A pair of Result and the payload, see decode(const
+     * std::string&). The payload is shared by all the calls, so it is
+     * immutable.
+     *   @retval InvalidToken There is no bearer token.
+     *
+     * @code
+     * auto [result, payload] = jwtUtil->decodeForRequest(req);
+     * if (result != tl::jwt::Ok)
+     * {
+     *     // 401
+     * }
+     * @endcode
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    std::pair<Result, std::shared_ptr<const Json::Value>> decodeForRequest(
+        const drogon::HttpRequestPtr& req);
+
+    /**
+     * @brief encode jwt from a struct which declares its claims, without
+     * building a Json::Value.
+     *
+     * @param data The struct to be encoded. The fields named "iss", "sub",
+     * "aud", "iat", ... may be overriden, the same as encode(const
+     * Json::Value&).
+     *
+     * @see field
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    template <ClaimsStruct T>
+    std::string encode(const T& data)
+    {
+        auto config = snapshot();
+        detail::Arena arena;
+        std::pmr::string payload(&arena);
+        config->serialize(data, payload);
+        return config->sign(payload);
+    }
+
+    /**
+     * @brief encode jwt into a caller provided buffer. The length of the
+     * token is computed before writing, so the token is written in its final
+     * place without any temporary string.
+     *
+     * @param data A Json::Value or a struct which declares its claims.
+     * @param out The buffer to write the token into.
+     *
+     * @return The length of the token. If it is larger than out.size(),
+     * nothing is written, and the caller can retry with a larger buffer.
+     *
+     * @code
+     * char buf[1024];
+     * auto len = jwtUtil->encodeTo(data, buf);
+     * if (len <= sizeof(buf))
+     * {
+     *     // use std::string_view(buf, len)
+     * }
+     * @endcode
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    template <typename T>
+        requires ClaimsStruct<T> || std::is_same_v<T, Json::Value>
+    size_t encodeTo(const T& data, std::span<char> out)
+    {
+        auto config = snapshot();
+        detail::Arena arena;
+        std::pmr::string payload(&arena);
+        config->serialize(data, payload);
+        const auto& header = config->compress(payload);
+        auto length = config->tokenLength(header, payload.size());
+        if (length <= out.size())
+        {
+            config->signTo(header, payload, out.data());
+        }
+        return length;
+    }
+
+    /**
+     * @brief encode jwt and append it to a trantor::MsgBuffer, e.g. the body
+     * of a response which is being built.
+     *
+     * @return The length of the appended token.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    template <typename T>
+        requires ClaimsStruct<T> || std::is_same_v<T, Json::Value>
+    size_t encodeTo(const T& data, trantor::MsgBuffer& out)
+    {
+        auto config = snapshot();
+        detail::Arena arena;
+        std::pmr::string payload(&arena);
+        config->serialize(data, payload);
+        const auto& header = config->compress(payload);
+        auto length = config->tokenLength(header, payload.size());
+        out.ensureWritableBytes(length);
+        config->signTo(header, payload, out.beginWrite());
+        out.hasWritten(length);
+        return length;
+    }
+
+    /**
+     * @brief decode jwt into a struct which declares its claims. The payload
+     * is scanned only once, and the claims are read into the fields directly.
+     * The claims which are not declared by T are ignored, and the fields
+     * which are not in the payload keep their default values.
+     *
+     * @param token The jwt string to be decoded.
+     *
+     * @return A pair of Result and the struct, see decode(const
+     * std::string&).
+     *   @retval InvalidPayload The payload is not a JSON object, or a claim
+     * does not match the type of its field.
+     *
+     * @code
+     * auto [result, user] = jwtUtil->decode<UserClaims>(token);
+     * if (result == Ok)
+     * {
+     *     LOG_INFO << user->uid;
+     * }
+     * @endcode
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    template <ClaimsStruct T>
+    std::pair<Result, std::optional<T>> decode(std::string_view token)
+    {
+        auto config = snapshot();
+        detail::Arena arena;
+        std::pmr::string buffer(&arena);
+        std::string_view payload;
+        auto result = config->verify(token, buffer, payload);
+        if (result != Ok)
+        {
+            return {result, std::nullopt};
+        }
+
+        std::optional<T> claims{std::in_place};
+        std::optional<int64_t> exp, nbf;
+        std::optional<ClaimPolicy::Matcher> matcher;
+        if (config->policy_)
+        {
+            matcher.emplace(*config->policy_);
+        }
+        json::Scanner scanner(payload);
+        auto ok = scanner.forEachMember([&](auto key, json::Scanner& s) {
+            if (matcher)
+            {
+                matcher->onMember(key, s);
+            }
+            if (!detail::readTimeClaim(key, s, exp, nbf))
+            {
+                return false;
+            }
+            bool matched;
+            if (!detail::readField(s, key, *claims, matched))
+            {
+                return false;
+            }
+            return matched || s.skipValue();
+        });
+        if (!ok || !scanner.atEnd())
+        {
+            return {InvalidPayload, std::nullopt};
+        }
+
+        result = config->validateTime(exp, nbf);
+        if (result == Ok && matcher)
+        {
+            result = matcher->finish();
+        }
+        if (result != Ok)
+        {
+            return {result, std::nullopt};
+        }
+        return {Ok, std::move(claims)};
+    }
+
+    /**
+     * @brief refresh jwt for sliding sessions. The token is verified once,
+     * then its payload is copied except the claims set by the plugin ("iat",
+     * "exp", "nbf", "jti", ...), which are written again with the current
+     * time, and the new payload is signed. No Json::Value is built.
+     *
+     * @param token The jwt string to be refreshed, which must be valid.
+     *
+     * @return A pair of Result and the new token. If the Result is not Ok,
+     * the token is empty, see decode(const std::string&).
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    std::pair<Result, std::string> refresh(std::string_view token);
+
+    /**
+     * @brief encode a CBOR Web Token (RFC 8392) in COSE_Mac0 format, which is
+     * smaller than jwt and is parsed without scanning text. The same secret,
+     * algorithm and payload config are used as encode(). The registered
+     * claims use the integer keys, "jti" is written as "cti". With the keys
+     * of setKeys(), the kid of the first key is in the unprotected header.
+     *
+     * @param data The payload to be encoded, see encode(const Json::Value&).
+     *
+     * @return The binary token, tagged by CWT and COSE_Mac0.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    std::string encodeCwt(const Json::Value& data);
+
+    /**
+     * @brief decode a CBOR Web Token in COSE_Mac0 format, both of the tags
+     * are optional. With the keys of setKeys(), the token is verified by the
+     * key of the kid in its unprotected header.
+     *
+     * @param token The binary token to be decoded.
+     *
+     * @return A pair of Result and the payload, see decode(const
+     * std::string&). The integer keys of the registered claims are named,
+     * the other byte strings are read as base64url strings.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    std::pair<Result, std::shared_ptr<Json::Value>> decodeCwt(
+        std::string_view token);
+
+    /**
+     * @brief sign a detached payload (RFC 7797), e.g. a large webhook body,
+     * which is fed chunk by chunk. The header has `"b64":false`, so the
+     * payload is signed as it is, and the token is "header..signature". The
+     * payload is sent beside the token.
+     *
+     * @code
+     * auto signer = jwtUtil->signDetached();
+     * for (auto chunk : body)
+     * {
+     *     signer.update(chunk);
+     * }
+     * req->addHeader("X-Signature", signer.finish());
+     * @endcode
+     *
+     * @throw std::invalid_argument If the algorithm is not HMAC.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    DetachedSigner signDetached();
+
+    /**
+     * @brief verify a detached payload (RFC 7797) chunk by chunk, e.g. as
+     * the body of a request is received, so the memory does not grow with
+     * the body. The time claims are not checked, since there is no payload
+     * of claims.
+     *
+     * @param token The token "header..signature".
+     *
+     * @code
+     * auto verifier = jwtUtil->verifyDetached(req->getHeader("X-Signature"));
+     * // for each chunk of the body
+     * verifier.update(chunk);
+     * // at the end of the body
+     * if (verifier.finish() == tl::jwt::Ok)
+     * {
+     * }
+     * @endcode
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    DetachedVerifier verifyDetached(std::string_view token);
+
+    /**
+     * @brief verify many tokens together. The header, the signature and the
+     * time claims of each token are checked, without building any
+     * Json::Value. The configuration, the matcher of the policy, the key of
+     * the last non-canonical header and the signing contexts of the thread
+     * are found once and shared by the tokens, while the signatures are
+     * still checked one by one.
+     *
+     * @param tokens The jwt strings to be verified.
+     *
+     * @return The Result of each token, in the same order.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    std::vector<Result> verifyBatch(std::span<const std::string_view> tokens);
+
+    /**
+     * @brief verify the token of a WebSocket connection once, and attach the
+     * claims to the context of the connection, so the messages are not
+     * checked again. A timer on the IO loop of the connection closes it with
+     * CloseCode::kViolation when the token expires, or calls onExpired
+     * instead.
+     *
+     * It must be called on the IO loop of the connection, e.g. in
+     * handleNewConnection(). Calling it again replaces the session, and the
+     * previous timer is canceled. The context of the connection is owned by
+     * the plugin, so the application must not set its own one. The timer
+     * follows the clock of the plugin, see setClock(): it fires after as
+     * many seconds as decode() would still accept the token.
+     *
+     * @param conn The connection.
+     * @param token The jwt string, e.g. from the upgrade request.
+     * @param onExpired Called when the token expires instead of closing the
+     * connection.
+     *
+     * @return The Result of decoding the token, the connection is not
+     * changed if it is not Ok.
+     *
+     * @throw std::logic_error If it is not called on an IO loop, or the
+     * connection has a context which is not set by bindConnection().
+     *
+     * @code
+     * void handleNewConnection(const HttpRequestPtr& req,
+     *                          const WebSocketConnectionPtr& conn) override
+     * {
+     *     auto token = req->getParameter("token");
+     *     if (jwtUtil->bindConnection(conn, token) != tl::jwt::Ok)
+     *     {
+     *         conn->shutdown(CloseCode::kViolation);
+     *     }
+     * }
+     *
+     * void handleNewMessage(const WebSocketConnectionPtr& conn,
+     *                       std::string&& message,
+     *                       const WebSocketMessageType& type) override
+     * {
+     *     auto session = tl::jwt::JwtUtil::sessionOf(conn);
+     *     // nullptr if the token has expired
+     * }
+     * @endcode
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    Result bindConnection(const drogon::WebSocketConnectionPtr& conn,
+                          std::string_view token,
+                          ExpiredCallback onExpired = nullptr);
+
+    /**
+     * @brief The session of a connection which is bound by bindConnection().
+     *
+     * @return nullptr if it is not bound or the token has expired, or the
+     * context of the connection is not a session.
+     *
+     * @date 2026-10-19
+     * @since v0.3.0
+     */
+    static std::shared_ptr<const WebSocketSession> sessionOf(
+        const drogon::WebSocketConnectionPtr& conn);
+
     void shutdown() override;
 
   private:
+    /**
+     * @brief The effective configuration, with the key material and the
+     * serialized static claims. A published snapshot is never changed, and
+     * every thread reads its own copy, see snapshot(). The helpers of encoding
+     * and decoding are its members, so they only read the snapshot.
+     */
+    struct alignas(64) Snapshot : std::enable_shared_from_this<Snapshot>
+    {
+        /// Serialize the payload with the registered claims.
+        void serialize(const Json::Value& data,
+                       std::pmr::string& payload) const;
+
+        /// Append the members of the payload except the registered claims,
+        /// and return whether nothing is appended.
+        bool writeMembers(const Json::Value& data,
+                          std::pmr::string& payload) const;
+
+        /// encode(const Json::Value&) through the cache of the thread.
+        std::string encodeCached(const Json::Value& data) const;
+
+        /// Sign a payload of the members which are written by
+        /// writeMembers().
+        std::string mint(std::string_view members) const;
+
+        template <ClaimsStruct T>
+        void serialize(const T& data, std::pmr::string& payload) const
+        {
+            payload += '{';
+            auto written =
+                detail::writeFields(payload, data, [this](auto name) {
+                    return isOverridden(name);
+                });
+            writeRegisteredClaims(payload, !written);
+            payload += '}';
+        }
+
+        /// Build the token from the serialized payload.
+        std::string sign(std::pmr::string& payload) const;
+
+        /// Compress the payload in place if it is enabled and the payload is
+        /// large enough, and return the header to sign it with.
+        const std::string& compress(std::pmr::string& payload) const;
+
+        /// The length of the token whose payload has `payloadSize` bytes.
+        size_t tokenLength(const std::string& header,
+                           size_t payloadSize) const;
+
+        /// Write the token to out, which has at least tokenLength() bytes.
+        void signTo(const std::string& header,
+                    std::string_view payload,
+                    char* out) const;
+
+        /**
+         * @brief What verifyBatch() finds once for many tokens: the key of
+         * the last non-canonical header, and the contexts of the thread.
+         */
+        struct BatchState
+        {
+            /// Points into the previous token.
+            std::string_view header;
+            Result headerError{Ok};
+            const HmacKey* headerKey{nullptr};
+            bool compressed{false};
+#ifdef TL_JWT_USE_OPENSSL
+            const OpenSslHmac* macKey{nullptr};
+            EVP_MAC_CTX* macContext{nullptr};
+            std::optional<AsymmetricKey::Verifier> verifier;
+#endif
+        };
+
+        /**
+         * @brief Check the header and the signature, and decode the payload.
+         *
+         * @param buffer The storage of the decoded payload.
+         * @param payload Points to the decoded payload, which is valid until
+         * the next call on the same thread, if it is inflated.
+         * @param batch Shared by the tokens of a batch, or nullptr.
+         */
+        Result verify(std::string_view token,
+                      std::pmr::string& buffer,
+                      std::string_view& payload,
+                      BatchState* batch = nullptr) const;
+
+        /// Check a header which is not header_ or zipHeader_, and find its
+        /// key.
+        Result checkHeader(std::string_view header,
+                           const HmacKey*& hmac,
+                           bool& compressed) const;
+
+        /// Sign the message by the key of the algorithm, write the signature
+        /// to out and return its size.
+        size_t signMessage(std::string_view message, unsigned char* out) const;
+
+        /// Verify the base64url encoded signature of the message, by the
+        /// HMAC key if the algorithm is not asymmetric.
+        bool verifySignature(std::string_view message,
+                             std::string_view signature,
+                             const HmacKey& hmac,
+                             BatchState* batch = nullptr) const;
+
+        /// The size of the signature in bytes.
+        size_t signatureSize() const;
+
+        /// Check the "exp" and "nbf" claims.
+        Result validateTime(std::optional<int64_t> exp,
+                            std::optional<int64_t> nbf) const;
+
+        /// Whether the claim is always set by the plugin while encoding.
+        bool isOverridden(std::string_view claim) const;
+
+        /// Append the claims which are set by the plugin while encoding.
+        void writeRegisteredClaims(std::pmr::string& payload,
+                                   bool first) const;
+
+        Algorithm alg_{HS256};
+        HmacKey key_;
+#ifdef TL_JWT_USE_OPENSSL
+        std::shared_ptr<const AsymmetricKey> asymmetricKey_;
+#endif
+        /// The keys selected by "kid", the first one is alg_ and key_.
+        std::shared_ptr<const KeySet> keys_;
+        /// The base64url encoded headers which are signed with, the second
+        /// one has `"zip":"DEF"`.
+        std::string header_;
+        std::string zipHeader_;
+        // payload
+        std::string iss_;
+        std::string sub_;
+        std::string aud_;
+        /// The members of iss_, sub_ and aud_, e.g. `"iss":"a","sub":"b"`.
+        std::string staticClaims_;
+
+        bool zip_{false};
+        size_t zipThreshold_{1024};
+
+        int64_t exp_{1800};
+        int64_t nbf_{-1};
+
+        std::shared_ptr<const Clock> clock_{std::make_shared<SystemClock>()};
+        int64_t leeway_{0};
+
+        std::shared_ptr<const ClaimPolicy> policy_;
+        bool jti_ = false;
+
+        /// The part of the lifetime after which the cached tokens are
+        /// minted again, 0 if they are not cached.
+        double refreshAfter_{0};
+
+        struct CachedToken
+        {
+            std::string token;
+            int64_t iat;
+            /// The minting is queued to the loop.
+            bool refreshing{false};
+        };
+
+        struct StringHash
+        {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view str) const
+            {
+                return std::hash<std::string_view>()(str);
+            }
+        };
+
+        /// Keyed by the members of the payloads, only the copies of the
+        /// threads are used.
+        mutable std::unordered_map<std::string,
+                                   CachedToken,
+                                   StringHash,
+                                   std::equal_to<>>
+            tokens_;
+    };
+
+    /**
+     * @brief The snapshot of the current thread, which is copied from draft_
+     * again after it is published. Every public method reads it once and
+     * holds it until it returns, since the thread may drop it meanwhile,
+     * e.g. by a nested call after a setter. So every call increments and
+     * decrements the count of the shared_ptr, which is atomic but not
+     * contended, since the snapshot is only shared by its own thread.
+     */
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    /// Publish draft_ to all threads, mutex_ must be locked.
+    void publish();
+
+    /// decode(const std::string&) with the snapshot of the caller, which
+    /// returns the time claims as well.
+    std::pair<Result, std::shared_ptr<Json::Value>> decodeJson(
+        const Snapshot& config,
+        std::string_view token,
+        std::optional<int64_t>& exp,
+        std::optional<int64_t>& nbf);
+
+    /// Rebuild the key of draft_ after the secret, the keys or the algorithm
+    /// is changed, mutex_ must be locked.
+    void updateKey();
+
+    /// Guards the members below, which are only used by the setters.
+    mutable std::mutex mutex_;
     std::string secret_;
-    Algorithm alg_;
-    // payload
-    std::shared_ptr<std::string> iss_;
-    std::shared_ptr<std::string> sub_;
-    std::shared_ptr<std::string> aud_;
-
-    int exp_{1800};
-    int nbf_{-1};
-    bool jti_ = false;
+    /// The "alg" setting, draft_.alg_ is the algorithm of the key set if any.
+    Algorithm alg_{HS256};
+    CryptoBackend backend_{CryptoBackend::Builtin};
+    std::string privateKeyPem_;
+    std::string publicKeyPem_;
+    /// Attached to the IO loops if the "clock" setting is "coarse".
+    std::shared_ptr<CoarseClock> coarseClock_;
+    /// The configuration which is being changed.
+    Snapshot draft_;
+
+    /// Owns the snapshots of the threads, which are dropped after the
+    /// plugin is destroyed.
+    detail::CacheOwner owner_;
+    /// The key of the results of decodeForRequest() in the attributes.
+    const std::string attributeKey_{"tl::jwt::JwtUtil#" +
+                                    std::to_string(owner_.id())};
+    /// Bumped by publish(), on its own cache line, which is only written by
+    /// the setters.
+    alignas(64) std::atomic<uint64_t> generation_{0};
+
+    /// Reloads the "keys_file" setting, it is destroyed first, so its thread
+    /// never outlives the other members.
+    std::unique_ptr<KeyFileWatcher> watcher_;
 };
 
 }  // namespace tl::jwt
@@ -0,0 +1,242 @@
+/**
+ * @file KeySet.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "KeySet.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include "Base64Url.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+string encodeHeader(string_view json)
+{
+    string header(base64url::encodedLength(json.size()), '\0');
+    base64url::encode(json.data(), json.size(), header.data());
+    return header;
+}
+}  // namespace
+
+KeySet::KeySet(string_view jwks, CryptoBackend backend)
+    : jwks_(jwks), backend_(backend)
+{
+    Json::Value root;
+    string errors;
+    unique_ptr<Json::CharReader> reader(
+        Json::CharReaderBuilder().newCharReader());
+    if (!reader->parse(jwks.data(),
+                       jwks.data() + jwks.size(),
+                       &root,
+                       &errors))
+    {
+        throw invalid_argument("The key set is not JSON: " + errors);
+    }
+    if (!root.isObject() || !root["keys"].isArray() || root["keys"].empty())
+    {
+        throw invalid_argument("The key set must have a \"keys\" array");
+    }
+    if (root["keys"].size() > maxKeys)
+    {
+        throw invalid_argument("The key set has too many keys");
+    }
+
+    for (const auto& jwk : root["keys"])
+    {
+        if (!jwk.isObject() || jwk["kty"].asString() != "oct")
+        {
+            throw invalid_argument("Only the \"oct\" keys are supported");
+        }
+        if (!jwk["kid"].isString() || jwk["kid"].asString().empty() ||
+            !jwk["alg"].isString() || !jwk["k"].isString())
+        {
+            throw invalid_argument(
+                "A key must have the \"kid\", \"alg\" and \"k\" strings");
+        }
+        auto kid = jwk["kid"].asString();
+        if (find(kid))
+        {
+            throw invalid_argument("Duplicate kid: " + kid);
+        }
+        auto alg = jwk["alg"].asString();
+        if (alg != "HS256" && alg != "HS384" && alg != "HS512")
+        {
+            throw invalid_argument("Unsupported algorithm of the key " + kid +
+                                   ": " + alg);
+        }
+
+        auto encoded = jwk["k"].asString();
+        string secret(base64url::decodedLength(encoded.size()), '\0');
+        auto length = base64url::decode(encoded, secret.data());
+        if (length < 0)
+        {
+            throw invalid_argument("The key " + kid +
+                                   " is not base64url encoded");
+        }
+        secret.resize(length);
+
+        pmr::string header;
+        header += "{\"alg\":\"" + alg + "\",\"typ\":\"JWT\",\"kid\":";
+        json::writeString(header, kid);
+        keys_.push_back(Key{kid,
+                            fromString(alg),
+                            makeHmacKey(fromString(alg), backend, secret),
+                            encodeHeader(header + "}"),
+                            encodeHeader(header + ",\"zip\":\"DEF\"}")});
+    }
+}
+
+const KeySet::Key* KeySet::find(string_view kid) const
+{
+    // a few keys, the linear search is faster than hashing the kid
+    auto it = find_if(keys_.begin(), keys_.end(), [kid](const Key& key) {
+        return key.kid == kid;
+    });
+    return it == keys_.end() ? nullptr : &*it;
+}
+
+KeyFileWatcher::KeyFileWatcher(string path, string content, Callback onChange)
+    : path_(std::move(path)),
+      content_(std::move(content)),
+      onChange_(std::move(onChange))
+{
+#ifdef __linux__
+    // watch the directory, the file may be replaced by a rename, or be a
+    // symlink into a directory which is swapped, e.g. a mounted ConfigMap
+    auto directory = filesystem::path(path_).parent_path();
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0 ||
+        inotify_add_watch(inotifyFd_,
+                          directory.empty() ? "." : directory.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        auto error = errno;
+        if (inotifyFd_ >= 0)
+        {
+            close(inotifyFd_);
+        }
+        if (stopFd_ >= 0)
+        {
+            close(stopFd_);
+        }
+        throw system_error(error, generic_category(), "inotify " + path_);
+    }
+#endif
+    thread_ = thread([this]() { run(); });
+}
+
+KeyFileWatcher::~KeyFileWatcher()
+{
+#ifdef __linux__
+    uint64_t one = 1;
+    [[maybe_unused]] auto n = write(stopFd_, &one, sizeof(one));
+    thread_.join();
+    close(inotifyFd_);
+    close(stopFd_);
+#else
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stopped_.notify_all();
+    thread_.join();
+#endif
+}
+
+void KeyFileWatcher::reload()
+{
+    ifstream file(path_, ios::binary);
+    if (!file)
+    {
+        // it is being replaced, the next event reads it
+        return;
+    }
+    string content(istreambuf_iterator<char>(file), {});
+    if (content == content_)
+    {
+        return;
+    }
+    content_ = std::move(content);
+    onChange_(content_);
+}
+
+#ifdef __linux__
+void KeyFileWatcher::run()
+{
+    auto name = filesystem::path(path_).filename().string();
+    pollfd fds[] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+
+        // drain the events, and reload once for all of them
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(inotifyFd_, buffer, sizeof(buffer))) > 0)
+        {
+            for (auto* p = buffer; p < buffer + length;)
+            {
+                auto* event = reinterpret_cast<inotify_event*>(p);
+                // an entry of another name may be the target of the file,
+                // reload() skips the unchanged content
+                if ((event->mask & (IN_MOVED_TO | IN_CREATE | IN_Q_OVERFLOW)) ||
+                    (event->len > 0 && name == event->name))
+                {
+                    changed = true;
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (changed)
+        {
+            reload();
+        }
+    }
+}
+#else
+void KeyFileWatcher::run()
+{
+    error_code error;
+    auto lastWrite = filesystem::last_write_time(path_, error);
+    unique_lock<mutex> lock(mutex_);
+    while (!stopped_.wait_for(lock, chrono::seconds(1), [this]() {
+        return stopping_;
+    }))
+    {
+        auto time = filesystem::last_write_time(path_, error);
+        if (!error && time != lastWrite)
+        {
+            lastWrite = time;
+            reload();
+        }
+    }
+}
+#endif
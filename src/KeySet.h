@@ -0,0 +1,151 @@
+/**
+ * @file KeySet.h
+ * @brief The HMAC keys of a JWK Set, which are selected by the "kid" of the
+ * tokens, and the watcher which reloads them from a file.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "JwtUtil.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief The symmetric keys of a JWK Set (RFC 7517), which are keyed once
+ * when the set is parsed. The first key signs the new tokens, and every key
+ * verifies the tokens whose header has its "kid", so a key can be rotated by
+ * adding the new key in front of the old one.
+ *
+ * @code
+ * {
+ *     "keys": [
+ *         {"kty": "oct", "kid": "2026-10", "alg": "HS256", "k": "c2VjcmV0"},
+ *         {"kty": "oct", "kid": "2026-09", "alg": "HS256", "k": "b2xk"}
+ *     ]
+ * }
+ * @endcode
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class KeySet
+{
+  public:
+    struct Key
+    {
+        std::string kid;
+        Algorithm alg;
+        HmacKey hmac;
+        /// The base64url encoded headers with the kid, the second one has
+        /// `"zip":"DEF"`.
+        std::string header;
+        std::string zipHeader;
+    };
+
+    /**
+     * @param jwks The JSON text of the set.
+     * @param backend The implementation of HMAC.
+     *
+     * @throw std::invalid_argument If the set is malformed, empty, or has a
+     * key which is not an "oct" key of HS256, HS384 or HS512.
+     */
+    KeySet(std::string_view jwks, CryptoBackend backend);
+
+    /// The key which signs the new tokens.
+    const Key& signingKey() const
+    {
+        return keys_.front();
+    }
+
+    /// The key of the kid, or nullptr.
+    const Key* find(std::string_view kid) const;
+
+    /// The implementation of HMAC which keyed the set.
+    CryptoBackend backend() const
+    {
+        return backend_;
+    }
+
+    /// The JSON text of the set, to key it again with another backend.
+    const std::string& jwks() const
+    {
+        return jwks_;
+    }
+
+    /// The most keys of a set.
+    static constexpr size_t maxKeys = 64;
+
+  private:
+    std::vector<Key> keys_;
+    std::string jwks_;
+    CryptoBackend backend_;
+};
+
+#ifdef TL_JWT_USE_OPENSSL
+static_assert(KeySet::maxKeys <= OpenSslHmac::maxThreadContexts,
+              "every key of a set must keep its context on a thread");
+#endif
+
+/**
+ * @brief Watch a file on a background thread, and call back with its new
+ * content after it is written or replaced by a rename, or after an entry is
+ * created or moved into its directory, e.g. the `..data` symlink of a
+ * Kubernetes volume. It is inotify on Linux, and the modification time is
+ * polled every second elsewhere.
+ *
+ * The callback is called on the watching thread, which is joined by the
+ * destructor.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class KeyFileWatcher
+{
+  public:
+    using Callback = std::function<void(const std::string& content)>;
+
+    /**
+     * @param path The file, whose directory must exist.
+     * @param content The current content, which is not called back again.
+     *
+     * @throw std::system_error If the file can not be watched.
+     */
+    KeyFileWatcher(std::string path, std::string content, Callback onChange);
+
+    KeyFileWatcher(const KeyFileWatcher&) = delete;
+    KeyFileWatcher& operator=(const KeyFileWatcher&) = delete;
+
+    ~KeyFileWatcher();
+
+  private:
+    void run();
+    /// Read the file, and call back if its content is changed.
+    void reload();
+
+    std::string path_;
+    std::string content_;
+    Callback onChange_;
+#ifdef __linux__
+    int inotifyFd_{-1};
+    /// An eventfd which wakes up the thread to stop it.
+    int stopFd_{-1};
+#else
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stopping_{false};
+#endif
+    std::thread thread_;
+};
+
+}  // namespace tl::jwt
@@ -0,0 +1,176 @@
+/**
+ * @file OpenSslHmac.h
+ * @brief HMAC over OpenSSL 3 EVP_MAC, which has the same interface as Hmac.
+ * It is only compiled when TL_JWT_USE_OPENSSL is defined.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#ifdef TL_JWT_USE_OPENSSL
+
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "detail/ThreadCache.h"
+
+namespace tl::jwt
+{
+
+/**
+ * @brief A HMAC key of OpenSSL. Every thread keeps its own EVP_MAC_CTX which
+ * is keyed once, and is reset by the cached key for each message.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class OpenSslHmac
+{
+  public:
+    /// An incremental signing, which owns a copy of the keyed context.
+    class Context
+    {
+      public:
+        explicit Context(EVP_MAC_CTX* ctx) : ctx_(ctx)
+        {
+        }
+
+        Context(Context&& other) noexcept
+            : ctx_(std::exchange(other.ctx_, nullptr))
+        {
+        }
+
+        Context(const Context&) = delete;
+        Context& operator=(const Context&) = delete;
+
+        ~Context()
+        {
+            EVP_MAC_CTX_free(ctx_);
+        }
+
+        void update(const void* data, size_t len)
+        {
+            EVP_MAC_update(ctx_, static_cast<const unsigned char*>(data), len);
+        }
+
+      private:
+        friend class OpenSslHmac;
+        EVP_MAC_CTX* ctx_;
+    };
+
+    /**
+     * @param digest The name of the digest, e.g. "SHA256".
+     * @param digestSize The size of the digest in bytes.
+     */
+    OpenSslHmac(const char* digest, size_t digestSize, std::string_view secret)
+        : digestSize(digestSize),
+          digest_(digest),
+          secret_(secret)
+    {
+    }
+
+    const size_t digestSize;
+
+    Context begin() const
+    {
+        auto* ctx = EVP_MAC_CTX_dup(threadContext());
+        if (!ctx || !EVP_MAC_init(ctx, nullptr, 0, nullptr))
+        {
+            EVP_MAC_CTX_free(ctx);
+            throw std::runtime_error("EVP_MAC_init failed");
+        }
+        return Context(ctx);
+    }
+
+    void finish(Context& context, unsigned char* out) const
+    {
+        size_t len;
+        EVP_MAC_final(context.ctx_, out, &len, digestSize);
+    }
+
+    void sign(std::string_view message, unsigned char* out) const
+    {
+        sign(threadContext(), message, out);
+    }
+
+    /**
+     * @brief The same as above, by the keyed context of threadContext(),
+     * which is found once for many messages, e.g. for a batch of tokens.
+     */
+    void sign(EVP_MAC_CTX* ctx, std::string_view message, unsigned char* out)
+        const
+    {
+        size_t len;
+        // reset by the cached key
+        if (!EVP_MAC_init(ctx, nullptr, 0, nullptr) ||
+            !EVP_MAC_update(ctx,
+                            reinterpret_cast<const unsigned char*>(
+                                message.data()),
+                            message.size()) ||
+            !EVP_MAC_final(ctx, out, &len, digestSize))
+        {
+            throw std::runtime_error("EVP_MAC failed");
+        }
+    }
+
+    /// The number of keys whose contexts are kept by each thread, a full key
+    /// set (KeySet::maxKeys) beside the keys of a few secrets, so the keys
+    /// of a set do not evict each other.
+    static constexpr size_t maxThreadContexts = 80;
+
+    /// The keyed context of the current thread, which is valid until the
+    /// context of another key is found on the same thread.
+    EVP_MAC_CTX* threadContext() const
+    {
+        using Cache = detail::ThreadCache<KeyedContext, maxThreadContexts>;
+        return Cache::get(owner_, [this]() { return newContext(); }).get();
+    }
+
+  private:
+    struct FreeContext
+    {
+        void operator()(EVP_MAC_CTX* ctx) const
+        {
+            EVP_MAC_CTX_free(ctx);
+        }
+    };
+
+    using KeyedContext = std::unique_ptr<EVP_MAC_CTX, FreeContext>;
+
+    KeyedContext newContext() const
+    {
+        static EVP_MAC* mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+        KeyedContext ctx(EVP_MAC_CTX_new(mac));
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                             const_cast<char*>(digest_),
+                                             0),
+            OSSL_PARAM_construct_end()};
+        if (!ctx ||
+            !EVP_MAC_init(ctx.get(),
+                          reinterpret_cast<const unsigned char*>(
+                              secret_.data()),
+                          secret_.size(),
+                          params))
+        {
+            throw std::runtime_error("EVP_MAC_init failed");
+        }
+        return ctx;
+    }
+
+    const char* digest_;
+    std::string secret_;
+    /// The copies share the contexts of the threads.
+    detail::CacheOwner owner_;
+};
+
+}  // namespace tl::jwt
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * @file RequestClaims.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "JwtUtil.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+using namespace drogon;
+
+using namespace tl::jwt;
+
+namespace
+{
+using RequestClaims = pair<Result, shared_ptr<const Json::Value>>;
+
+/// The token of "Authorization: Bearer <token>", or empty.
+string_view bearerToken(const HttpRequestPtr& req)
+{
+    constexpr string_view scheme = "Bearer ";
+    string_view value = req->getHeader("Authorization");
+    // the scheme is case insensitive, RFC 7235
+    if (value.size() <= scheme.size() ||
+        !equal(scheme.begin(), scheme.end(), value.begin(), [](char a, char b) {
+            return tolower(static_cast<unsigned char>(a)) ==
+                   tolower(static_cast<unsigned char>(b));
+        }))
+    {
+        return {};
+    }
+    value.remove_prefix(scheme.size());
+    while (!value.empty() && value.front() == ' ')
+    {
+        value.remove_prefix(1);
+    }
+    return value;
+}
+}  // namespace
+
+RequestClaims JwtUtil::decodeForRequest(const HttpRequestPtr& req)
+{
+    const auto& attributes = req->attributes();
+    if (attributes->find(attributeKey_))
+    {
+        return attributes->get<RequestClaims>(attributeKey_);
+    }
+
+    RequestClaims claims{InvalidToken, nullptr};
+    auto token = bearerToken(req);
+    if (!token.empty())
+    {
+        optional<int64_t> exp, nbf;
+        claims = decodeJson(*snapshot(), token, exp, nbf);
+    }
+    attributes->insert(attributeKey_, claims);
+    return claims;
+}
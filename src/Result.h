@@ -0,0 +1,66 @@
+/**
+ * @file Result.h
+ * @brief The results of decoding jwt tokens.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <string>
+
+namespace tl::jwt
+{
+
+/// The result of decoding a jwt token.
+enum Result
+{
+    Ok = 0,            ///< parsing success
+    InvalidToken,      ///< token format is not correct
+    InvalidSignature,  ///< signature is not correct
+    InvalidHeader,     ///< header is not correct
+    InvalidAlgorithm,  ///< not supported algorithm
+    InvalidPayload,    ///< payload is not correct
+    InvalidNotBefore,  ///< token is not valid before nbf
+    ExpiredToken,      ///< token is expired
+    MissingClaim,      ///< a claim required by the policy is missing
+    InvalidClaim,      ///< a claim does not match the policy
+    InvalidAudience,   ///< aud is not accepted by the policy
+};
+
+/**
+ * @date 2025-05-26
+ * @since v0.0.1
+ */
+inline std::string toString(Result result)
+{
+    switch (result)
+    {
+        case Ok:
+            return "Ok";
+        case InvalidToken:
+            return "InvalidToken";
+        case InvalidSignature:
+            return "InvalidSignature";
+        case InvalidHeader:
+            return "InvalidHeader";
+        case InvalidAlgorithm:
+            return "InvalidAlgorithm";
+        case InvalidPayload:
+            return "InvalidPayload";
+        case InvalidNotBefore:
+            return "InvalidNotBefore";
+        case ExpiredToken:
+            return "ExpiredToken";
+        case MissingClaim:
+            return "MissingClaim";
+        case InvalidClaim:
+            return "InvalidClaim";
+        case InvalidAudience:
+            return "InvalidAudience";
+    }
+    return "Unknown";
+}
+
+}  // namespace tl::jwt
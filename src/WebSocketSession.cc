@@ -0,0 +1,114 @@
+/**
+ * @file WebSocketSession.cc
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include "JwtUtil.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace drogon;
+
+using namespace tl::jwt;
+
+namespace
+{
+/// The deleter of the sessions, which tells them from the other contexts of
+/// the connections by std::get_deleter().
+struct DeleteSession
+{
+    void operator()(WebSocketSession* session) const
+    {
+        delete session;
+    }
+};
+
+/// About a century, in seconds.
+constexpr double maxTimerDelay = 3.2e9;
+
+bool isSession(const shared_ptr<void>& context)
+{
+    return get_deleter<DeleteSession>(context) != nullptr;
+}
+}  // namespace
+
+Result JwtUtil::bindConnection(const WebSocketConnectionPtr& conn,
+                               string_view token,
+                               ExpiredCallback onExpired)
+{
+    auto* loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+    if (!loop)
+    {
+        throw logic_error("bindConnection must be called in an IO loop");
+    }
+    if (conn->hasContext() && !isSession(conn->getContext<void>()))
+    {
+        throw logic_error("The context of the connection is set by others");
+    }
+
+    auto session =
+        shared_ptr<WebSocketSession>(new WebSocketSession, DeleteSession());
+    // the timer reads the leeway of the same configuration
+    auto config = snapshot();
+    optional<int64_t> nbf;
+    auto [result, claims] = decodeJson(*config, token, session->exp, nbf);
+    if (result != Ok)
+    {
+        return result;
+    }
+    session->claims = std::move(claims);
+    session->loop = loop;
+
+    // the timer of the previous token must not close the connection
+    if (auto previous = sessionOf(conn))
+    {
+        previous->loop->invalidateTimer(previous->timerId);
+    }
+
+    // the token is valid during the second of exp and the leeway by the
+    // clock of the plugin, see validateTime(), the sum in double never
+    // overflows
+    auto delay = session->exp ? static_cast<double>(*session->exp) +
+                                    config->leeway_ + 1 - config->clock_->now()
+                              : maxTimerDelay;
+    // trantor counts the microseconds in int64, a later token never expires
+    if (delay < maxTimerDelay)
+    {
+        weak_ptr<WebSocketConnection> weakConn = conn;
+        weak_ptr<WebSocketSession> weakSession = session;
+        session->timerId = loop->runAfter(
+            max(delay, 0.0),
+            [weakConn, weakSession, onExpired = std::move(onExpired)]() {
+                auto conn = weakConn.lock();
+                auto session = weakSession.lock();
+                if (!conn || !session || sessionOf(conn) != session)
+                {
+                    return;
+                }
+                conn->clearContext();
+                if (onExpired)
+                {
+                    onExpired(conn);
+                }
+                else
+                {
+                    conn->shutdown(CloseCode::kViolation, "Token expired");
+                }
+            });
+    }
+    conn->setContext(session);
+    return Ok;
+}
+
+shared_ptr<const WebSocketSession> JwtUtil::sessionOf(
+    const WebSocketConnectionPtr& conn)
+{
+    if (!conn->hasContext() || !isSession(conn->getContext<void>()))
+    {
+        return nullptr;
+    }
+    return conn->getContext<WebSocketSession>();
+}
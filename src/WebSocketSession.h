@@ -0,0 +1,55 @@
+/**
+ * @file WebSocketSession.h
+ * @brief The claims of a WebSocket connection, which are verified once when
+ * the connection is established.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <drogon/WebSocketConnection.h>
+#include <json/value.h>
+#include <trantor/net/EventLoop.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace tl::jwt
+{
+
+/**
+ * @brief Called on the IO loop of the connection when its token expires,
+ * instead of closing the connection. The session is already removed from
+ * the connection, so it can ask the client to authenticate again and bind
+ * a new token.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+using ExpiredCallback =
+    std::function<void(const drogon::WebSocketConnectionPtr& conn)>;
+
+/**
+ * @brief The context of a WebSocket connection which is bound by
+ * JwtUtil::bindConnection().
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+struct WebSocketSession
+{
+    /// The payload, see JwtUtil::decode().
+    std::shared_ptr<const Json::Value> claims;
+    /// The "exp" claim, the connection never expires if it is empty.
+    std::optional<int64_t> exp;
+
+    /// The timer which enforces exp, it is invalidated when the session is
+    /// replaced.
+    trantor::EventLoop* loop{nullptr};
+    trantor::TimerId timerId{0};
+};
+
+}  // namespace tl::jwt
@@ -0,0 +1,126 @@
+/**
+ * @file ThreadCache.h
+ * @brief The values which every thread keeps for a few objects, e.g. the
+ * keyed contexts of the keys and the snapshots of the configuration.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tl::jwt::detail
+{
+
+/**
+ * @brief The identity of an object whose values are kept by ThreadCache. The
+ * copies share the identity, and every thread drops their values after the
+ * last copy is destroyed.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+class CacheOwner
+{
+  public:
+    CacheOwner()
+        : id_(nextId_.fetch_add(1, std::memory_order_relaxed)),
+          // only the control block is used, to tell the threads
+          alive_(nullptr, [](void*) {
+              destroyed_.fetch_add(1, std::memory_order_release);
+          })
+    {
+    }
+
+    /// Never reused by another owner.
+    uint64_t id() const
+    {
+        return id_;
+    }
+
+  private:
+    template <typename, size_t>
+    friend class ThreadCache;
+
+    uint64_t id_;
+    std::shared_ptr<void> alive_;
+    static inline std::atomic<uint64_t> nextId_{1};
+    /// Bumped when the last copy of an owner is destroyed.
+    static inline std::atomic<uint64_t> destroyed_{0};
+};
+
+/**
+ * @brief A value of each owner on each thread, which is created once by the
+ * thread and then reused without locking. A thread keeps up to `capacity`
+ * owners, and drops the oldest one for a new one, since the owners are
+ * replaced rarely. The values of the destroyed owners are dropped by the next
+ * get() of the thread.
+ *
+ * @tparam Value A movable type.
+ *
+ * @date 2026-10-19
+ * @since v0.3.0
+ */
+template <typename Value, size_t capacity = 16>
+class ThreadCache
+{
+  public:
+    /**
+     * @brief The value of the owner on the current thread, which is created
+     * by `make()` if it is missing.
+     *
+     * @return A reference which is valid until the next get() of the same
+     * cache on the same thread.
+     */
+    template <typename Make>
+    static Value& get(const CacheOwner& owner, Make&& make)
+    {
+        thread_local Entries entries;
+        auto destroyed = CacheOwner::destroyed_.load(std::memory_order_acquire);
+        if (destroyed != entries.destroyed)
+        {
+            entries.destroyed = destroyed;
+            std::erase_if(entries.list, [](const Entry& entry) {
+                return entry.alive.expired();
+            });
+        }
+        for (auto& entry : entries.list)
+        {
+            if (entry.id == owner.id_)
+            {
+                return entry.value;
+            }
+        }
+
+        // nothing is dropped if make() throws
+        auto value = make();
+        if (entries.list.size() >= capacity)
+        {
+            entries.list.erase(entries.list.begin());
+        }
+        entries.list.push_back(Entry{owner.id_, owner.alive_, std::move(value)});
+        return entries.list.back().value;
+    }
+
+  private:
+    struct Entry
+    {
+        uint64_t id;
+        std::weak_ptr<void> alive;
+        Value value;
+    };
+
+    struct Entries
+    {
+        std::vector<Entry> list;
+        /// The CacheOwner::destroyed_ of the last sweep.
+        uint64_t destroyed{0};
+    };
+};
+
+}  // namespace tl::jwt::detail
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace tl::jwt::sha2
@@ -88,20 +90,6 @@ constexpr std::array<uint64_t, 8> sha512H = {0x6a09e667f3bcc908,
                                              0x5be0cd19137e2179};
 }  // namespace constants
 
-inline uint32_t bswap32(uint32_t x)
-{
-    return ((x & 0xff000000) >> 24) | ((x & 0x00ff0000) >> 8) |
-           ((x & 0x0000ff00) << 8) | ((x & 0x000000ff) << 24);
-}
-
-inline uint64_t bswap64(uint64_t x)
-{
-    return ((x & 0xff00000000000000) >> 56) | ((x & 0x00ff000000000000) >> 40) |
-           ((x & 0x0000ff0000000000) >> 24) | ((x & 0x000000ff00000000) >> 8) |
-           ((x & 0x00000000ff000000) << 8) | ((x & 0x0000000000ff0000) << 24) |
-           ((x & 0x000000000000ff00) << 40) | ((x & 0x00000000000000ff) << 56);
-}
-
 inline uint32_t ROTR(uint32_t X, uint8_t offset)
 {
     return (X >> offset) | (X << (32 - offset));
@@ -172,54 +160,92 @@ inline uint64_t Maj(uint64_t X, uint64_t Y, uint64_t Z)
     return (X & Y) ^ (X & Z) ^ (Y & Z);
 }
 
+/**
+ * @brief Incremental sha224/sha256. The input can be fed by several calls of
+ * update(), and the context can be copied to reuse the absorbed prefix, which
+ * is how HMAC caches the hashed ipad and opad blocks.
+ */
 template <bool is224 = false>
-std::string sha2_32(const std::string &input)
+class Sha2_32
 {
-    uint64_t size = input.size();
-    auto cha = 64 - (size + 9) % 64;
-    if (cha == 64)
-    {
-        cha = 0;
-    }
-    size <<= 3;
-    std::string data = input;
-    data.append(1, 0x80);
-    data.append(cha, 0x00);
-    auto *pSize = reinterpret_cast<unsigned char *>(&size);
-    for (int i = 7; i >= 0; --i)
+  public:
+    static constexpr size_t blockSize = 64;
+    static constexpr size_t digestSize = is224 ? 28 : 32;
+
+    Sha2_32() : H_(is224 ? constants::sha224H : constants::sha256H)
     {
-        data.append(1, pSize[i]);
     }
 
-    std::array<uint32_t, 8> H;
-    if constexpr (is224)
+    void update(const void *data, size_t len)
     {
-        H = constants::sha224H;
+        auto *p = static_cast<const unsigned char *>(data);
+        length_ += len;
+        if (bufferSize_ > 0)
+        {
+            auto n = std::min(len, blockSize - bufferSize_);
+            std::memcpy(buffer_ + bufferSize_, p, n);
+            bufferSize_ += n;
+            p += n;
+            len -= n;
+            if (bufferSize_ < blockSize)
+            {
+                return;
+            }
+            compress(buffer_);
+            bufferSize_ = 0;
+        }
+        for (; len >= blockSize; p += blockSize, len -= blockSize)
+        {
+            compress(p);
+        }
+        std::memcpy(buffer_, p, len);
+        bufferSize_ = len;
     }
-    else
+
+    /// Write digestSize bytes to out. The context can not be used any more.
+    void final(unsigned char *out)
     {
-        H = constants::sha256H;
+        uint64_t size = length_ << 3;
+        buffer_[bufferSize_++] = 0x80;
+        if (bufferSize_ > blockSize - 8)
+        {
+            std::memset(buffer_ + bufferSize_, 0, blockSize - bufferSize_);
+            compress(buffer_);
+            bufferSize_ = 0;
+        }
+        std::memset(buffer_ + bufferSize_, 0, blockSize - 8 - bufferSize_);
+        for (int i = 0; i < 8; ++i)
+        {
+            buffer_[blockSize - 1 - i] = static_cast<unsigned char>(size >> (i * 8));
+        }
+        compress(buffer_);
+        for (size_t i = 0; i < digestSize / 4; ++i)
+        {
+            out[i * 4] = static_cast<unsigned char>(H_[i] >> 24);
+            out[i * 4 + 1] = static_cast<unsigned char>(H_[i] >> 16);
+            out[i * 4 + 2] = static_cast<unsigned char>(H_[i] >> 8);
+            out[i * 4 + 3] = static_cast<unsigned char>(H_[i]);
+        }
     }
 
-    uint32_t W[64] = {0};
-
-    for (int i = 0; i < data.size() / 64; ++i)
+  private:
+    void compress(const unsigned char *block)
     {
-        for (int j = 0; j < 64; j = j + 4)
+        uint32_t W[64];
+        for (int j = 0; j < 16; ++j)
         {
-            uint32_t k = (i << 6) + j;
-            W[j / 4] = (static_cast<uint32_t>(data[k] & 0xff) << 24) |
-                       (static_cast<uint32_t>(data[k + 1] & 0xff) << 16) |
-                       (static_cast<uint32_t>(data[k + 2] & 0xff) << 8) |
-                       static_cast<uint32_t>(data[k + 3] & 0xff);
+            W[j] = (static_cast<uint32_t>(block[j * 4]) << 24) |
+                   (static_cast<uint32_t>(block[j * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(block[j * 4 + 2]) << 8) |
+                   static_cast<uint32_t>(block[j * 4 + 3]);
         }
         for (int i = 16; i < 64; i++)
         {
             W[i] = s1(W[i - 2]) + W[i - 7] + s0(W[i - 15]) + W[i - 16];
         }
 
-        uint32_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4], f = H[5],
-                 g = H[6], h = H[7];
+        uint32_t a = H_[0], b = H_[1], c = H_[2], d = H_[3], e = H_[4],
+                 f = H_[5], g = H_[6], h = H_[7];
         for (int i = 0; i < 64; ++i)
         {
             uint32_t t1 = h + S1(e) + Ch(e, f, g) + constants::K32[i] + W[i];
@@ -233,89 +259,108 @@ std::string sha2_32(const std::string &input)
             b = a;
             a = t1 + t2;
         }
-        H[0] += a;
-        H[1] += b;
-        H[2] += c;
-        H[3] += d;
-        H[4] += e;
-        H[5] += f;
-        H[6] += g;
-        H[7] += h;
-    }
-    H[0] = bswap32(H[0]);
-    H[1] = bswap32(H[1]);
-    H[2] = bswap32(H[2]);
-    H[3] = bswap32(H[3]);
-    H[4] = bswap32(H[4]);
-    H[5] = bswap32(H[5]);
-    H[6] = bswap32(H[6]);
-    H[7] = bswap32(H[7]);
-
-    std::string result;
-    for (int i = 0; i < 7; ++i)
-    {
-        result.append(reinterpret_cast<char *>(&H[i]), 4);
+        H_[0] += a;
+        H_[1] += b;
+        H_[2] += c;
+        H_[3] += d;
+        H_[4] += e;
+        H_[5] += f;
+        H_[6] += g;
+        H_[7] += h;
     }
-    if constexpr (!is224)
-    {
-        result.append(reinterpret_cast<char *>(&H[7]), 4);
-    }
-    return result;
-}
 
+    std::array<uint32_t, 8> H_;
+    unsigned char buffer_[blockSize];
+    size_t bufferSize_{0};
+    uint64_t length_{0};
+};
+
+/**
+ * @brief Incremental sha384/sha512, see Sha2_32.
+ */
 template <bool is384 = false>
-std::string sha2_64(const std::string &input)
+class Sha2_64
 {
-    unsigned long long size = input.size();
-    auto cha = 128 - (size + 17) % 128;
-    if (cha == 128)
-    {
-        cha = 0;
-    }
-    size <<= 3;
-    std::string data = input;
-    data.append(1, 0x80);
-    data.append(cha, 0x00);
-    auto *pSize = reinterpret_cast<unsigned char *>(&size);
-    data.append(8, 0x00);
-    for (int i = 7; i >= 0; --i)
+  public:
+    static constexpr size_t blockSize = 128;
+    static constexpr size_t digestSize = is384 ? 48 : 64;
+
+    Sha2_64() : H_(is384 ? constants::sha384H : constants::sha512H)
     {
-        data.append(1, pSize[i]);
     }
 
-    std::array<uint64_t, 8> H;
-    if constexpr (is384)
+    void update(const void *data, size_t len)
     {
-        H = constants::sha384H;
+        auto *p = static_cast<const unsigned char *>(data);
+        length_ += len;
+        if (bufferSize_ > 0)
+        {
+            auto n = std::min(len, blockSize - bufferSize_);
+            std::memcpy(buffer_ + bufferSize_, p, n);
+            bufferSize_ += n;
+            p += n;
+            len -= n;
+            if (bufferSize_ < blockSize)
+            {
+                return;
+            }
+            compress(buffer_);
+            bufferSize_ = 0;
+        }
+        for (; len >= blockSize; p += blockSize, len -= blockSize)
+        {
+            compress(p);
+        }
+        std::memcpy(buffer_, p, len);
+        bufferSize_ = len;
     }
-    else
+
+    /// Write digestSize bytes to out. The context can not be used any more.
+    void final(unsigned char *out)
     {
-        H = constants::sha512H;
+        // the high 64 bits of the 128 bits length are always 0
+        uint64_t size = length_ << 3;
+        buffer_[bufferSize_++] = 0x80;
+        if (bufferSize_ > blockSize - 16)
+        {
+            std::memset(buffer_ + bufferSize_, 0, blockSize - bufferSize_);
+            compress(buffer_);
+            bufferSize_ = 0;
+        }
+        std::memset(buffer_ + bufferSize_, 0, blockSize - 8 - bufferSize_);
+        for (int i = 0; i < 8; ++i)
+        {
+            buffer_[blockSize - 1 - i] = static_cast<unsigned char>(size >> (i * 8));
+        }
+        compress(buffer_);
+        for (size_t i = 0; i < digestSize / 8; ++i)
+        {
+            for (int j = 0; j < 8; ++j)
+            {
+                out[i * 8 + j] = static_cast<unsigned char>(H_[i] >> (56 - j * 8));
+            }
+        }
     }
 
-    uint64_t W[80] = {0};
-
-    for (int i = 0; i < data.size() / 128; ++i)
+  private:
+    void compress(const unsigned char *block)
     {
-        for (int j = 0; j < 128; j = j + 8)
+        uint64_t W[80];
+        for (int j = 0; j < 16; ++j)
         {
-            uint64_t k = (i << 7) + j;
-            W[j / 8] = (static_cast<uint64_t>(data[k] & 0xff) << 56) |
-                       (static_cast<uint64_t>(data[k + 1] & 0xff) << 48) |
-                       (static_cast<uint64_t>(data[k + 2] & 0xff) << 40) |
-                       (static_cast<uint64_t>(data[k + 3] & 0xff) << 32) |
-                       (static_cast<uint64_t>(data[k + 4] & 0xff) << 24) |
-                       (static_cast<uint64_t>(data[k + 5] & 0xff) << 16) |
-                       (static_cast<uint64_t>(data[k + 6] & 0xff) << 8) |
-                       (static_cast<uint64_t>(data[k + 7] & 0xff));
+            W[j] = 0;
+            for (int k = 0; k < 8; ++k)
+            {
+                W[j] = (W[j] << 8) | block[j * 8 + k];
+            }
         }
         for (int i = 16; i < 80; i++)
         {
             W[i] = s1(W[i - 2]) + W[i - 7] + s0(W[i - 15]) + W[i - 16];
         }
 
-        uint64_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4], f = H[5],
-                 g = H[6], h = H[7];
+        uint64_t a = H_[0], b = H_[1], c = H_[2], d = H_[3], e = H_[4],
+                 f = H_[5], g = H_[6], h = H_[7];
         for (int i = 0; i < 80; ++i)
         {
             uint64_t t1 = h + S1(e) + Ch(e, f, g) + constants::K64[i] + W[i];
@@ -329,54 +374,54 @@ std::string sha2_64(const std::string &input)
             b = a;
             a = t1 + t2;
         }
-        H[0] += a;
-        H[1] += b;
-        H[2] += c;
-        H[3] += d;
-        H[4] += e;
-        H[5] += f;
-        H[6] += g;
-        H[7] += h;
-    }
-    H[0] = bswap64(H[0]);
-    H[1] = bswap64(H[1]);
-    H[2] = bswap64(H[2]);
-    H[3] = bswap64(H[3]);
-    H[4] = bswap64(H[4]);
-    H[5] = bswap64(H[5]);
-    H[6] = bswap64(H[6]);
-    H[7] = bswap64(H[7]);
-
-    std::string result;
-    for (int i = 0; i < 6; ++i)
-    {
-        result.append(reinterpret_cast<char *>(&H[i]), 8);
-    }
-    if constexpr (!is384)
-    {
-        result.append(reinterpret_cast<char *>(&H[6]), 8);
-        result.append(reinterpret_cast<char *>(&H[7]), 8);
+        H_[0] += a;
+        H_[1] += b;
+        H_[2] += c;
+        H_[3] += d;
+        H_[4] += e;
+        H_[5] += f;
+        H_[6] += g;
+        H_[7] += h;
     }
+
+    std::array<uint64_t, 8> H_;
+    unsigned char buffer_[blockSize];
+    size_t bufferSize_{0};
+    uint64_t length_{0};
+};
+
+using Sha224 = Sha2_32<true>;
+using Sha256 = Sha2_32<>;
+using Sha384 = Sha2_64<true>;
+using Sha512 = Sha2_64<>;
+
+template <typename Hash>
+std::string hash(const std::string &input)
+{
+    Hash ctx;
+    ctx.update(input.data(), input.size());
+    std::string result(Hash::digestSize, '\0');
+    ctx.final(reinterpret_cast<unsigned char *>(result.data()));
     return result;
 }
 
 inline std::string sha224(const std::string &input)
 {
-    return sha2_32<true>(input);
+    return hash<Sha224>(input);
 }
 
 inline std::string sha256(const std::string &input)
 {
-    return sha2_32(input);
+    return hash<Sha256>(input);
 }
 
 inline std::string sha384(const std::string &input)
 {
-    return sha2_64<true>(input);
+    return hash<Sha384>(input);
 }
 
 inline std::string sha512(const std::string &input)
 {
-    return sha2_64(input);
+    return hash<Sha512>(input);
 }
 }  // namespace tl::jwt::sha2
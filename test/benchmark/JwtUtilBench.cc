@@ -0,0 +1,106 @@
+/**
+ * @file JwtUtilBench.cc
+ * @brief Measure the cost of encoding and decoding tokens in each crypto
+ * backend, format and algorithm.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include "../../src/JwtUtil.h"
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+/// Run f() n times, return the nanoseconds per call.
+double measure(const function<void()>& f, int n)
+{
+    // warm up
+    for (int i = 0; i < n / 10; ++i)
+    {
+        f();
+    }
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        f();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - begin).count() / n;
+}
+
+Json::Value samplePayload()
+{
+    Json::Value data;
+    data["uid"] = 123456789;
+    data["username"] = "tanglong3bf";
+    data["tenant"] = "example";
+    data["roles"][0] = "reader";
+    data["roles"][1] = "writer";
+    return data;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? stoi(argv[1]) : 100000;
+    auto data = samplePayload();
+
+    printf("%-8s %-8s %-6s %8s %12s %12s\n",
+           "crypto",
+           "alg",
+           "format",
+           "bytes",
+           "encode(ns)",
+           "decode(ns)");
+    for (auto [crypto, alg] : {pair{"builtin", "HS256"},
+                               pair{"builtin", "HS384"},
+                               pair{"builtin", "HS512"},
+                               pair{"openssl", "HS256"},
+                               pair{"openssl", "HS384"},
+                               pair{"openssl", "HS512"}})
+    {
+        if (!isAvailable(cryptoBackendFromString(crypto)))
+        {
+            continue;
+        }
+        auto jwtUtil = make_unique<JwtUtil>();
+        jwtUtil->setSecret("benchmark secret");
+        Json::Value config;
+        config["alg"] = alg;
+        config["crypto"] = crypto;
+        config["payload"]["iss"] = "tanglong3bf";
+        jwtUtil->initAndStart(config);
+
+        auto jwt = jwtUtil->encode(data);
+        auto encodeJwt = measure([&] { jwtUtil->encode(data); }, n);
+        auto decodeJwt = measure([&] { jwtUtil->decode(jwt); }, n);
+        printf("%-8s %-8s %-6s %8zu %12.1f %12.1f\n",
+               crypto,
+               alg,
+               "JWT",
+               jwt.size(),
+               encodeJwt,
+               decodeJwt);
+
+        auto cwt = jwtUtil->encodeCwt(data);
+        auto encodeCwt = measure([&] { jwtUtil->encodeCwt(data); }, n);
+        auto decodeCwt = measure([&] { jwtUtil->decodeCwt(cwt); }, n);
+        printf("%-8s %-8s %-6s %8zu %12.1f %12.1f\n",
+               crypto,
+               alg,
+               "CWT",
+               cwt.size(),
+               encodeCwt,
+               decodeCwt);
+        jwtUtil->shutdown();
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file JwtUtilLoadTest.cc
+ * @brief Drive a local drogon server with a JWT protected handler over
+ * loopback, and report the throughput and the latency of each number of IO
+ * threads and algorithm.
+ *
+ * usage:
+ *   JwtUtilLoadTest [max_threads] [seconds] [connections] [depth]
+ *   JwtUtilLoadTest --run threads alg seconds connections depth
+ *
+ * Every run starts its own process, since the drogon app can only run once.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include <drogon/drogon.h>
+#include <trantor/net/EventLoopThreadPool.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/JwtUtil.h"
+#ifdef TL_JWT_USE_OPENSSL
+#include <openssl/pem.h>
+#endif
+
+using namespace std;
+using namespace drogon;
+using namespace tl::jwt;
+
+namespace
+{
+constexpr uint16_t port = 18848;
+
+const char* const algorithms[] = {
+    "HS256",
+    "HS384",
+    "HS512",
+#ifdef TL_JWT_USE_OPENSSL
+    "EdDSA",
+    "ES256",
+#endif
+};
+
+#ifdef TL_JWT_USE_OPENSSL
+/// A new private key of EdDSA or ES256 in PEM.
+string generatePrivateKey(const string& alg)
+{
+    auto* key = alg == "EdDSA"
+                    ? EVP_PKEY_Q_keygen(nullptr, nullptr, "ED25519")
+                    : EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+    auto* bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+    char* data;
+    auto len = BIO_get_mem_data(bio, &data);
+    string pem(data, len);
+    BIO_free(bio);
+    EVP_PKEY_free(key);
+    return pem;
+}
+#endif
+
+shared_ptr<JwtUtil> makeJwtUtil(const string& alg)
+{
+    auto jwtUtil = make_shared<JwtUtil>();
+    jwtUtil->setSecret("load test secret");
+    Json::Value config;
+    config["alg"] = alg;
+    config["payload"]["iss"] = "tanglong3bf";
+    jwtUtil->initAndStart(config);
+#ifdef TL_JWT_USE_OPENSSL
+    if (isAsymmetric(fromString(alg)))
+    {
+        jwtUtil->setPemKeys(generatePrivateKey(alg));
+    }
+#endif
+    return jwtUtil;
+}
+
+/// The requests which are sent by the connections of one client loop, the
+/// latencies are only touched by that loop.
+struct ClientLoad
+{
+    vector<HttpClientPtr> clients;
+    vector<int64_t> latencies;
+};
+
+/// Send the next request of a client when the previous one is responded,
+/// until the deadline.
+void sendNext(const HttpClientPtr& client,
+              ClientLoad& load,
+              const string& authorization,
+              chrono::steady_clock::time_point deadline,
+              atomic<size_t>& inFlight,
+              promise<void>& done)
+{
+    auto begin = chrono::steady_clock::now();
+    if (begin >= deadline)
+    {
+        if (--inFlight == 0)
+        {
+            done.set_value();
+        }
+        return;
+    }
+    auto req = HttpRequest::newHttpRequest();
+    req->setPath("/auth");
+    req->addHeader("Authorization", authorization);
+    client->sendRequest(
+        req,
+        [client, &load, &authorization, deadline, &inFlight, &done, begin](
+            ReqResult result, const HttpResponsePtr& resp) {
+            if (result != ReqResult::Ok || resp->statusCode() != k200OK)
+            {
+                LOG_ERROR << "Request failed: " << static_cast<int>(result);
+                exit(1);
+            }
+            auto latency = chrono::steady_clock::now() - begin;
+            load.latencies.push_back(
+                chrono::duration_cast<chrono::nanoseconds>(latency).count());
+            sendNext(client, load, authorization, deadline, inFlight, done);
+        });
+}
+
+/// Run the server with the IO threads and the algorithm, and print a row.
+int runOnce(size_t threads,
+            const string& alg,
+            double seconds,
+            size_t connections,
+            size_t depth)
+{
+    auto jwtUtil = makeJwtUtil(alg);
+    Json::Value data;
+    data["uid"] = 123456789;
+    data["username"] = "tanglong3bf";
+    auto authorization = "Bearer " + jwtUtil->encode(data);
+
+    app().setLogLevel(trantor::Logger::kWarn);
+    app().setThreadNum(threads);
+    app().addListener("127.0.0.1", port);
+    app().registerHandler(
+        "/auth",
+        [jwtUtil](const HttpRequestPtr& req,
+                  function<void(const HttpResponsePtr&)>&& callback) {
+            auto resp = HttpResponse::newHttpResponse();
+            const auto& header = req->getHeader("authorization");
+            if (header.size() <= 7 ||
+                jwtUtil->decode(header.substr(7)).first != Ok)
+            {
+                resp->setStatusCode(k401Unauthorized);
+            }
+            callback(resp);
+        },
+        {Get});
+
+    promise<void> started;
+    thread server([&started]() {
+        app().getLoop()->queueInLoop([&started]() { started.set_value(); });
+        app().run();
+    });
+    started.get_future().get();
+
+    // the clients use the other cores, not the IO threads of the server
+    size_t cores = thread::hardware_concurrency();
+    auto clientThreads =
+        max<size_t>(1, min(connections, cores > threads ? cores - threads : 1));
+    trantor::EventLoopThreadPool pool(clientThreads, "client");
+    pool.start();
+    vector<ClientLoad> loads(clientThreads);
+    for (size_t i = 0; i < connections; ++i)
+    {
+        auto client =
+            HttpClient::newHttpClient("http://127.0.0.1:" + to_string(port),
+                                      pool.getLoop(i % clientThreads));
+        client->setPipeliningDepth(depth);
+        loads[i % clientThreads].clients.push_back(client);
+    }
+
+    atomic<size_t> inFlight{connections * depth};
+    promise<void> done;
+    auto begin = chrono::steady_clock::now();
+    auto deadline =
+        begin + chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::duration<double>(seconds));
+    for (size_t i = 0; i < clientThreads; ++i)
+    {
+        pool.getLoop(i)->queueInLoop([&load = loads[i],
+                                      &authorization,
+                                      deadline,
+                                      depth,
+                                      &inFlight,
+                                      &done]() {
+            for (auto& client : load.clients)
+            {
+                for (size_t d = 0; d < depth; ++d)
+                {
+                    sendNext(client,
+                             load,
+                             authorization,
+                             deadline,
+                             inFlight,
+                             done);
+                }
+            }
+        });
+    }
+    done.get_future().get();
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin)
+                       .count();
+
+    vector<int64_t> latencies;
+    for (auto& load : loads)
+    {
+        latencies.insert(latencies.end(),
+                         load.latencies.begin(),
+                         load.latencies.end());
+    }
+    auto percentile = [&latencies](double p) {
+        auto nth = latencies.begin() +
+                   static_cast<ptrdiff_t>(p * (latencies.size() - 1));
+        nth_element(latencies.begin(), nth, latencies.end());
+        return *nth / 1000.0;
+    };
+    if (latencies.empty())
+    {
+        LOG_ERROR << "No request is responded";
+        return 1;
+    }
+    printf("%8zu %-6s %12.0f %10.1f %10.1f %10.1f\n",
+           threads,
+           alg.c_str(),
+           latencies.size() / elapsed,
+           percentile(0.5),
+           percentile(0.99),
+           percentile(0.999));
+    fflush(stdout);
+
+    // the clients are destroyed in their own loops
+    for (size_t i = 0; i < clientThreads; ++i)
+    {
+        promise<void> cleared;
+        pool.getLoop(i)->runInLoop([&load = loads[i], &cleared]() {
+            load.clients.clear();
+            cleared.set_value();
+        });
+        cleared.get_future().get();
+    }
+    app().getLoop()->queueInLoop([]() { app().quit(); });
+    server.join();
+    return 0;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc == 7 && string(argv[1]) == "--run")
+    {
+        return runOnce(stoul(argv[2]),
+                       argv[3],
+                       stod(argv[4]),
+                       stoul(argv[5]),
+                       stoul(argv[6]));
+    }
+
+    size_t maxThreads =
+        argc > 1 ? stoul(argv[1])
+                 : max<unsigned>(1, thread::hardware_concurrency() / 2);
+    auto seconds = argc > 2 ? argv[2] : string("3");
+    auto connections = argc > 3 ? argv[3] : string("64");
+    auto depth = argc > 4 ? argv[4] : string("4");
+
+    printf("%8s %-6s %12s %10s %10s %10s\n",
+           "threads",
+           "alg",
+           "req/s",
+           "p50(us)",
+           "p99(us)",
+           "p999(us)");
+    fflush(stdout);
+    // 1, 2, 4, ... and max_threads
+    vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    for (auto threads : threadCounts)
+    {
+        for (auto alg : algorithms)
+        {
+            auto command = string(argv[0]) + " --run " + to_string(threads) +
+                           " " + alg + " " + seconds + " " + connections +
+                           " " + depth;
+            if (system(command.c_str()) != 0)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -14,6 +14,8 @@ int main(int argc, char *argv[])
     std::thread thr([&]() {
         // Queues the promise to be fulfilled after starting the loop
         app().getLoop()->queueInLoop([&p1]() { p1.set_value(); });
+        // for the WebSocket tests
+        app().addListener("127.0.0.1", testPort);
         app().run();
     });
 
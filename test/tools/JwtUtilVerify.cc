@@ -0,0 +1,284 @@
+/**
+ * @file JwtUtilVerify.cc
+ * @brief Verify the newline delimited tokens of files offline, and count them
+ * by Result.
+ *
+ * usage:
+ *   JwtUtilVerify [--threads n] [--each] [--at time] config.json file...
+ *
+ * config.json is the config of the plugin, e.g. secret, alg, public_key. The
+ * files are memory mapped, and the tokens are verified in place by all cores.
+ * With --each, the Result of every line is written in the input order,
+ * instead of the counts. With --at, exp and nbf are checked at the unix time
+ * instead of now, e.g. the time when the tokens were logged.
+ *
+ * @copyright Copyright (c) 2024 - 2025 tanglong3bf
+ * @license MIT License
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "../../src/Clock.h"
+#include "../../src/JwtUtil.h"
+
+using namespace std;
+using namespace tl::jwt;
+
+namespace
+{
+/// The bytes of a chunk, which is verified by one thread at a time.
+constexpr size_t chunkSize = 4 << 20;
+
+/// The number of tokens which are passed to verifyBatch() at once.
+constexpr size_t batchSize = 1024;
+
+constexpr size_t resultCount = InvalidAudience + 1;
+
+/// A read only mapping of a whole file.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const char* path)
+    {
+        auto fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            perror(path);
+            exit(1);
+        }
+        size_ = st.st_size;
+        if (size_ > 0)
+        {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED)
+            {
+                perror(path);
+                exit(1);
+            }
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (data_)
+        {
+            munmap(data_, size_);
+        }
+    }
+
+    string_view view() const
+    {
+        return {static_cast<const char*>(data_), size_};
+    }
+
+  private:
+    void* data_{nullptr};
+    size_t size_{0};
+};
+
+/// Split the data into chunks of about chunkSize bytes, at the newlines.
+void splitChunks(string_view data, vector<string_view>& chunks)
+{
+    while (!data.empty())
+    {
+        auto end = data.size() <= chunkSize ? string_view::npos
+                                            : data.find('\n', chunkSize);
+        end = end == string_view::npos ? data.size() : end + 1;
+        chunks.push_back(data.substr(0, end));
+        data.remove_prefix(end);
+    }
+}
+
+/// Verify the lines of a chunk, count them, and append the Result of each
+/// line to out if it is not null.
+void verifyChunk(JwtUtil& jwtUtil,
+                 string_view chunk,
+                 array<size_t, resultCount>& counts,
+                 string* out)
+{
+    vector<string_view> tokens;
+    tokens.reserve(batchSize);
+    auto flush = [&]() {
+        for (auto result : jwtUtil.verifyBatch(tokens))
+        {
+            ++counts[result];
+            if (out)
+            {
+                out->append(toString(result));
+                out->push_back('\n');
+            }
+        }
+        tokens.clear();
+    };
+    while (!chunk.empty())
+    {
+        auto end = chunk.find('\n');
+        auto line = chunk.substr(0, end);
+        chunk.remove_prefix(end == string_view::npos ? chunk.size() : end + 1);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        tokens.push_back(line);
+        if (tokens.size() == batchSize)
+        {
+            flush();
+        }
+    }
+    flush();
+}
+
+Json::Value readConfig(const char* path)
+{
+    ifstream file(path);
+    Json::Value config;
+    Json::CharReaderBuilder builder;
+    string errors;
+    if (!file || !Json::parseFromStream(builder, file, &config, &errors))
+    {
+        fprintf(stderr,
+                "Can not read the config %s: %s\n",
+                path,
+                errors.c_str());
+        exit(1);
+    }
+    return config;
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t threads = max(1u, thread::hardware_concurrency());
+    bool each = false;
+    optional<int64_t> at;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--each") == 0)
+        {
+            each = true;
+        }
+        else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc)
+        {
+            char* end;
+            at = strtoll(argv[++i], &end, 10);
+            if (*argv[i] == '\0' || *end != '\0')
+            {
+                fprintf(stderr, "Invalid time %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (argc - i < 2)
+    {
+        fprintf(stderr,
+                "usage: %s [--threads n] [--each] [--at time] config.json "
+                "file...\n",
+                argv[0]);
+        return 1;
+    }
+
+    JwtUtil jwtUtil;
+    jwtUtil.initAndStart(readConfig(argv[i++]));
+    if (at)
+    {
+        jwtUtil.setClock(make_shared<ManualClock>(*at));
+    }
+
+    vector<unique_ptr<MappedFile>> files;
+    vector<string_view> chunks;
+    for (; i < argc; ++i)
+    {
+        files.push_back(make_unique<MappedFile>(argv[i]));
+        splitChunks(files.back()->view(), chunks);
+    }
+
+    // the chunks are taken in order, and their outputs are written in order
+    atomic<size_t> nextChunk{0};
+    vector<string> outputs(each ? chunks.size() : 0);
+    vector<bool> finished(outputs.size());
+    size_t nextOutput = 0;
+    mutex outputMutex;
+    vector<array<size_t, resultCount>> counts(threads);
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            counts[t].fill(0);
+            for (size_t c; (c = nextChunk++) < chunks.size();)
+            {
+                verifyChunk(jwtUtil,
+                            chunks[c],
+                            counts[t],
+                            each ? &outputs[c] : nullptr);
+                if (!each)
+                {
+                    continue;
+                }
+                lock_guard<mutex> lock(outputMutex);
+                finished[c] = true;
+                for (; nextOutput < outputs.size() && finished[nextOutput];
+                     ++nextOutput)
+                {
+                    fwrite(outputs[nextOutput].data(),
+                           1,
+                           outputs[nextOutput].size(),
+                           stdout);
+                    string().swap(outputs[nextOutput]);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    if (!each)
+    {
+        for (size_t r = 0; r < resultCount; ++r)
+        {
+            size_t total = 0;
+            for (auto& threadCounts : counts)
+            {
+                total += threadCounts[r];
+            }
+            printf("%-24s %zu\n",
+                   toString(static_cast<Result>(r)).c_str(),
+                   total);
+        }
+    }
+    jwtUtil.shutdown();
+    return 0;
+}
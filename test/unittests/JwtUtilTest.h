@@ -1,7 +1,23 @@
 #include "../../src/JwtUtil.h"
+#include "../../src/Base64Url.h"
 #include <gtest/gtest.h>
 #include <drogon/drogon.h>
+#include <drogon/WebSocketClient.h>
+#include <drogon/WebSocketController.h>
 #include <json/value.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+#ifdef TL_JWT_USE_OPENSSL
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#endif
 
 TEST(TestToString, Test)
 {
@@ -144,6 +160,59 @@ TEST(TestDecode, InvalidAlgorithm)
     jwtUtil->shutdown();
 }
 
+TEST(TestDecode, NonCanonicalHeader)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    // {"typ":"JWT","alg":"HS256"}
+    auto result = jwtUtil->decode(
+        "eyJ0eXAiOiJKV1QiLCJhbGciOiJIUzI1NiJ9."
+        "eyJ1c2VyX2lkIjoxfQ.J_RIIkoOLNXtd5IZcEwaBDGKGA3VnnYmuXnmhsmDEOs");
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    jwtUtil->shutdown();
+}
+
+TEST(TestDecode, CachedHeader)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    // {"kid":"k1","alg":"HS256"}, parsed once and then cached
+    std::string token =
+        "eyJraWQiOiJrMSIsImFsZyI6IkhTMjU2In0."
+        "eyJ1c2VyX2lkIjoxfQ.NJIMG40jqkrjz2D_toy_Wo1Yc6v1KKgdiW0KUnux2js";
+    for (int i = 0; i < 3; ++i)
+    {
+        auto result = jwtUtil->decode(token);
+        ASSERT_EQ(result.first, tl::jwt::Ok)
+            << "result.first: " << toString(result.first);
+    }
+    // the forged headers are not cached, so they evict nothing
+    for (int i = 0; i < 200; ++i)
+    {
+        auto header = R"({"alg":"HS256","x":)" + std::to_string(i) + "}";
+        std::string forged(tl::jwt::base64url::encodedLength(header.size()),
+                           '\0');
+        tl::jwt::base64url::encode(header.data(), header.size(), forged.data());
+        forged += token.substr(token.find('.'));
+        EXPECT_EQ(jwtUtil->decode(forged).first, tl::jwt::InvalidSignature);
+        EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    }
+    // {"alg":"HS256","zip":"GZIP"}
+    auto result = jwtUtil->decode(
+        "eyJhbGciOiJIUzI1NiIsInppcCI6IkdaSVAifQ."
+        "eyJ1c2VyX2lkIjoxfQ._USytSazn_NqH8AEzRx6GAFhNz-T4zbf5aadOOoe384");
+    EXPECT_EQ(result.first, tl::jwt::InvalidHeader);
+    // {"alg":"HS512"}, which does not match the algorithm
+    result = jwtUtil->decode(
+        "eyJhbGciOiJIUzUxMiJ9."
+        "eyJ1c2VyX2lkIjoxfQ.fx9mFSHkdYkrpHYMSwoGO-WvCvMECsGaLct-_rwAwPg");
+    EXPECT_EQ(result.first, tl::jwt::InvalidAlgorithm);
+    jwtUtil->shutdown();
+}
+
 TEST(TestDecode, InvalidSignature)
 {
     auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
@@ -158,6 +227,39 @@ TEST(TestDecode, InvalidSignature)
     jwtUtil->shutdown();
 }
 
+TEST(TestDecode, KnownToken)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    // signed by another implementation
+    auto result = jwtUtil->decode(
+        "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9."
+        "eyJ1c2VyX2lkIjoxLCJ1c2VybmFtZSI6InRhbmdsb25nM2JmIn0."
+        "8S_gYJo5wxnEFbOWdjXngdiqlsC7s9rT5Y3_oWlZ5pM");
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ((*result.second)["user_id"].asInt(), 1);
+    EXPECT_EQ((*result.second)["username"].asString(), "tanglong3bf");
+    jwtUtil->shutdown();
+}
+
+TEST(TestDecode, MalformedPayload)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    // signed by another implementation, the payload {"uid":1,"name":"\q"}
+    // has an invalid escape sequence
+    auto result = jwtUtil->decode(
+        "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9."
+        "eyJ1aWQiOjEsIm5hbWUiOiJccSJ9."
+        "LOCzB_6p5kXpvIVaBxjpw7twJKH7KvCPNoUaydCM4JU");
+    EXPECT_EQ(result.first, tl::jwt::InvalidPayload);
+    EXPECT_EQ(result.second, nullptr);
+    jwtUtil->shutdown();
+}
+
 TEST(TestEncodeAndDecode, InvalidExp)
 {
     using namespace std::chrono;
@@ -207,6 +309,25 @@ TEST(TestEncodeAndDecode, OkWithNbf)
     jwtUtil->shutdown();
 }
 
+TEST(TestEncodeAndDecode, RealClaims)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    Json::Value data;
+    data["one"] = 1.0;
+    data["large"] = 1e300;
+    data["half"] = -0.5;
+    auto result = jwtUtil->decode(jwtUtil->encode(data));
+    ASSERT_EQ(result.first, tl::jwt::Ok);
+    auto& payload = *result.second;
+    EXPECT_EQ(payload["one"].type(), Json::realValue);
+    EXPECT_EQ(payload["one"].asDouble(), 1.0);
+    EXPECT_EQ(payload["large"].asDouble(), 1e300);
+    EXPECT_EQ(payload["half"].asDouble(), -0.5);
+    jwtUtil->shutdown();
+}
+
 TEST(TestOtherAlgorithms, HS384)
 {
     auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
@@ -240,3 +361,1268 @@ TEST(TestOtherAlgorithms, HS512)
     ASSERT_TRUE(payload->isObject());
     jwtUtil->shutdown();
 }
+
+TEST(TestClock, ManualClock)
+{
+    auto clock = std::make_shared<tl::jwt::ManualClock>(1000);
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["payload"]["exp"] = 60;
+    config["payload"]["nbf"] = 10;
+    jwtUtil->initAndStart(config);
+    jwtUtil->setClock(clock);
+    auto token = jwtUtil->encode({});
+
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::InvalidNotBefore);
+    clock->advance(10);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    clock->set(1060);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    clock->advance(1);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::ExpiredToken);
+
+    jwtUtil->setLeeway(5);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    clock->set(1005);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    clock->set(1066);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::ExpiredToken);
+    jwtUtil->shutdown();
+}
+
+TEST(TestClock, After2038)
+{
+    // 2100-01-01
+    auto clock = std::make_shared<tl::jwt::ManualClock>(4102444800);
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setClock(clock);
+    Json::Value data;
+    data["user_id"] = 1;
+    auto token = jwtUtil->encode(data);
+    ASSERT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    clock->advance(1801);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::ExpiredToken);
+    jwtUtil->shutdown();
+}
+
+TEST(TestClock, CoarseClockWithoutLoop)
+{
+    tl::jwt::CoarseClock clock;
+    EXPECT_NEAR(clock.now(), time(nullptr), 1);
+}
+
+TEST(TestSnapshot, SetFromOtherThread)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["secret"] = "tanglong3bf";
+    config["payload"]["iss"] = "tanglong3bf";
+    jwtUtil->initAndStart(config);
+    auto token = jwtUtil->encode({});
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+
+    // the snapshot of this thread is replaced after the change is published
+    std::thread([&jwtUtil]() { jwtUtil->setSecret("another secret"); })
+        .join();
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::InvalidSignature);
+    auto [result, payload] = jwtUtil->decode(jwtUtil->encode({}));
+    ASSERT_EQ(result, tl::jwt::Ok);
+    EXPECT_EQ((*payload)["iss"].asString(), "tanglong3bf");
+
+    // the snapshots of two instances on one thread are independent
+    tl::jwt::JwtUtil other;
+    other.initAndStart(config);
+    EXPECT_EQ(other.decode(token).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::InvalidSignature);
+}
+
+TEST(TestSnapshot, DroppedAfterDestroyed)
+{
+    auto clock = std::make_shared<tl::jwt::ManualClock>(1000);
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setClock(clock);
+    jwtUtil->encode({});
+    EXPECT_GT(clock.use_count(), 1);
+
+    // the snapshot of this thread is dropped by the next lookup
+    jwtUtil.reset();
+    tl::jwt::JwtUtil other;
+    other.initAndStart({});
+    other.encode({});
+    EXPECT_EQ(clock.use_count(), 1);
+}
+
+TEST(TestKeys, SelectByKid)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+    ]})");
+    auto oldToken = jwtUtil->encode({});
+    EXPECT_EQ(jwtUtil->decode(oldToken).first, tl::jwt::Ok);
+
+    // rotate: the new key signs, the old key still verifies
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"},
+        {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+    ]})");
+    auto newToken = jwtUtil->encode({});
+    EXPECT_EQ(newToken.substr(0, newToken.find('.')),
+              "eyJhbGciOiJIUzUxMiIsInR5cCI6IkpXVCIsImtpZCI6Im5ldyJ9");
+    EXPECT_EQ(jwtUtil->decode(oldToken).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->decode(newToken).first, tl::jwt::Ok);
+
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"}
+    ]})");
+    EXPECT_EQ(jwtUtil->decode(oldToken).first, tl::jwt::InvalidSignature);
+    EXPECT_EQ(jwtUtil->decode(newToken).first, tl::jwt::Ok);
+
+    EXPECT_THROW(jwtUtil->setKeys(R"({"keys": []})"), std::invalid_argument);
+    EXPECT_THROW(jwtUtil->setKeys(R"({"keys": [{"kty": "RSA"}]})"),
+                 std::invalid_argument);
+    EXPECT_EQ(jwtUtil->decode(newToken).first, tl::jwt::Ok);
+
+    // back to the secret
+    jwtUtil->setKeys("");
+    EXPECT_EQ(jwtUtil->decode(newToken).first, tl::jwt::InvalidAlgorithm);
+}
+
+TEST(TestKeys, VerifyBatch)
+{
+    for (auto backend : {tl::jwt::CryptoBackend::Builtin,
+                         tl::jwt::CryptoBackend::OpenSSL})
+    {
+        if (!tl::jwt::isAvailable(backend))
+        {
+            continue;
+        }
+        auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+        Json::Value config;
+        config["policy"]["required"].append("uid");
+        jwtUtil->initAndStart(config);
+        jwtUtil->setCryptoBackend(backend);
+        Json::Value data;
+        data["uid"] = 1;
+        jwtUtil->setKeys(R"({"keys": [
+            {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+        ]})");
+        auto oldToken = jwtUtil->encode(data);
+        auto oldWithoutUid = jwtUtil->encode({});
+        jwtUtil->setKeys(R"({"keys": [
+            {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"},
+            {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+        ]})");
+        auto newToken = jwtUtil->encode(data);
+        auto newWithoutUid = jwtUtil->encode({});
+        auto tampered = newToken;
+        tampered.back() = tampered.back() == 'A' ? 'B' : 'A';
+
+        // the keys alternate, and the policy is checked for every token
+        std::vector<std::string_view> tokens{newToken,
+                                             oldToken,
+                                             oldToken,
+                                             newWithoutUid,
+                                             oldWithoutUid,
+                                             tampered};
+        std::vector<tl::jwt::Result> expected{tl::jwt::Ok,
+                                              tl::jwt::Ok,
+                                              tl::jwt::Ok,
+                                              tl::jwt::MissingClaim,
+                                              tl::jwt::MissingClaim,
+                                              tl::jwt::InvalidSignature};
+        EXPECT_EQ(jwtUtil->verifyBatch(tokens), expected);
+        jwtUtil->shutdown();
+    }
+}
+
+TEST(TestKeys, SwitchBackend)
+{
+    if (!tl::jwt::isAvailable(tl::jwt::CryptoBackend::OpenSSL))
+    {
+        GTEST_SKIP() << "OpenSSL is not compiled in";
+    }
+    const char* jwks = R"({"keys": [
+        {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"},
+        {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+    ]})";
+    auto builtin = std::make_unique<tl::jwt::JwtUtil>();
+    builtin->initAndStart({});
+    builtin->setKeys(jwks);
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setKeys(jwks);
+    auto before = jwtUtil->encode({});
+
+    // the keys of the set are keyed again, not only the secret
+    jwtUtil->setCryptoBackend(tl::jwt::CryptoBackend::OpenSSL);
+    auto after = jwtUtil->encode({});
+    EXPECT_EQ(jwtUtil->decode(before).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->decode(after).first, tl::jwt::Ok);
+    EXPECT_EQ(builtin->decode(after).first, tl::jwt::Ok);
+    std::vector<std::string_view> tokens{before, after};
+    EXPECT_EQ(jwtUtil->verifyBatch(tokens),
+              std::vector<tl::jwt::Result>(2, tl::jwt::Ok));
+
+    jwtUtil->setCryptoBackend(tl::jwt::CryptoBackend::Builtin);
+    EXPECT_EQ(jwtUtil->decode(after).first, tl::jwt::Ok);
+    EXPECT_EQ(builtin->decode(jwtUtil->encode({})).first, tl::jwt::Ok);
+    builtin->shutdown();
+    jwtUtil->shutdown();
+}
+
+TEST(TestKeys, ReloadFile)
+{
+    auto path = std::filesystem::temp_directory_path() /
+                ("jwt-keys-" + std::to_string(time(nullptr)) + ".json");
+    auto write = [&path](const std::string& kid) {
+        auto temp = path;
+        temp += ".tmp";
+        std::ofstream(temp) << R"({"keys": [{"kty": "oct", "kid": ")" << kid
+                            << R"(", "alg": "HS256", "k": "c2VjcmV0"}]})";
+        std::filesystem::rename(temp, path);
+    };
+    write("first");
+
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["keys_file"] = path.string();
+    jwtUtil->initAndStart(config);
+    auto first = jwtUtil->encode({});
+    EXPECT_EQ(jwtUtil->decode(first).first, tl::jwt::Ok);
+
+    write("second");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (jwtUtil->decode(first).first == tl::jwt::Ok &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(jwtUtil->decode(first).first, tl::jwt::InvalidSignature);
+    EXPECT_EQ(jwtUtil->decode(jwtUtil->encode({})).first, tl::jwt::Ok);
+
+    jwtUtil->shutdown();
+    std::filesystem::remove(path);
+}
+
+TEST(TestKeys, ReloadSymlinkSwap)
+{
+    // the layout of a Kubernetes volume, whose ..data symlink is swapped
+    namespace fs = std::filesystem;
+    auto directory = fs::temp_directory_path() /
+                     ("jwt-keys-" + std::to_string(time(nullptr)) + ".d");
+    fs::create_directories(directory);
+    auto write = [&directory](const std::string& kid) {
+        fs::create_directory(directory / kid);
+        std::ofstream(directory / kid / "keys.json")
+            << R"({"keys": [{"kty": "oct", "kid": ")" << kid
+            << R"(", "alg": "HS256", "k": "c2VjcmV0"}]})";
+        fs::create_directory_symlink(kid, directory / "..data_tmp");
+        fs::rename(directory / "..data_tmp", directory / "..data");
+    };
+    write("first");
+    fs::create_symlink("..data/keys.json", directory / "keys.json");
+
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["keys_file"] = (directory / "keys.json").string();
+    jwtUtil->initAndStart(config);
+    auto first = jwtUtil->encode({});
+    EXPECT_EQ(jwtUtil->decode(first).first, tl::jwt::Ok);
+
+    write("second");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (jwtUtil->decode(first).first == tl::jwt::Ok &&
+           std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(jwtUtil->decode(first).first, tl::jwt::InvalidSignature);
+
+    jwtUtil->shutdown();
+    fs::remove_all(directory);
+}
+
+TEST(TestEncodeCache, ReuseAndRefresh)
+{
+    auto clock = std::make_shared<tl::jwt::ManualClock>(1000);
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["encode_cache"] = 0.5;
+    config["payload"]["exp"] = 100;
+    config["payload"]["jti"] = true;
+    jwtUtil->initAndStart(config);
+    jwtUtil->setClock(clock);
+
+    Json::Value service;
+    service["sub"] = "billing";
+    auto token = jwtUtil->encode(service);
+    EXPECT_EQ(jwtUtil->encode(service), token);
+    EXPECT_NE(jwtUtil->encode({}), token);
+
+    // minted again at once without a loop
+    clock->advance(50);
+    auto refreshed = jwtUtil->encode(service);
+    EXPECT_NE(refreshed, token);
+    EXPECT_EQ(jwtUtil->decode(refreshed).first, tl::jwt::Ok);
+
+    // minted again after the current task of the loop
+    trantor::EventLoop loop;
+    clock->advance(50);
+    EXPECT_EQ(jwtUtil->encode(service), refreshed);
+    loop.queueInLoop([&loop]() { loop.quit(); });
+    loop.loop();
+    auto next = jwtUtil->encode(service);
+    EXPECT_NE(next, refreshed);
+    EXPECT_EQ(jwtUtil->decode(next).first, tl::jwt::Ok);
+
+    jwtUtil->setEncodeCache(0);
+    EXPECT_NE(jwtUtil->encode(service), next);
+    EXPECT_THROW(jwtUtil->setEncodeCache(2), std::invalid_argument);
+}
+
+TEST(TestDetached, SignAndVerify)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["secret"] = "tanglong3bf";
+    jwtUtil->initAndStart(config);
+    std::string body(1 << 20, 'x');
+
+    auto signer = jwtUtil->signDetached();
+    for (size_t i = 0; i < body.size(); i += 4096)
+    {
+        signer.update(std::string_view(body).substr(i, 4096));
+    }
+    auto token = signer.finish();
+    EXPECT_EQ(token.substr(0, token.find('.')),
+              "eyJhbGciOiJIUzI1NiIsImI2NCI6ZmFsc2UsImNyaXQiOlsiYjY0Il19");
+    EXPECT_EQ(token.find(".."), token.find('.'));
+
+    // the chunks are split differently
+    auto verifier = jwtUtil->verifyDetached(token);
+    verifier.update(std::string_view(body).substr(0, 1000));
+    verifier.update(std::string_view(body).substr(1000));
+    EXPECT_EQ(verifier.finish(), tl::jwt::Ok);
+
+    auto tampered = jwtUtil->verifyDetached(token);
+    tampered.update(body);
+    tampered.update("y");
+    EXPECT_EQ(tampered.finish(), tl::jwt::InvalidSignature);
+
+    // the header must have "b64":false
+    EXPECT_EQ(jwtUtil->verifyDetached(jwtUtil->encode({})).finish(),
+              tl::jwt::InvalidToken);
+    auto signature = token.substr(token.rfind('.') + 1);
+    EXPECT_EQ(jwtUtil->verifyDetached("eyJhbGciOiJIUzI1NiJ9.." + signature)
+                  .finish(),
+              tl::jwt::InvalidHeader);
+}
+
+TEST(TestDetached, Rfc7797Example)
+{
+    // RFC 7797 section 4.2
+    std::string key = "AyM1SysPpbyDfgZld3umj1qzKObwVMkoqQ-EstJQLr_T-1qS0gZH"
+                      "75aKtMN3Yj0iPS4hcgUuTwjAzZr1Z9CAow";
+    std::string secret(tl::jwt::base64url::decodedLength(key.size()), '\0');
+    secret.resize(tl::jwt::base64url::decode(key, secret.data()));
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setSecret(secret);
+
+    std::string expected =
+        "eyJhbGciOiJIUzI1NiIsImI2NCI6ZmFsc2UsImNyaXQiOlsiYjY0Il19"
+        "..A5dxf2s96_n5FLueVuW1Z_vh161FwXZC4YLPff6dmDY";
+    auto signer = jwtUtil->signDetached();
+    signer.update("$.02");
+    EXPECT_EQ(signer.finish(), expected);
+
+#ifdef TL_JWT_USE_OPENSSL
+    jwtUtil->setCryptoBackend(tl::jwt::CryptoBackend::OpenSSL);
+    auto verifier = jwtUtil->verifyDetached(expected);
+    verifier.update("$.");
+    verifier.update("02");
+    EXPECT_EQ(verifier.finish(), tl::jwt::Ok);
+#endif
+}
+
+TEST(TestDecodeForRequest, Memoized)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["secret"] = "tanglong3bf";
+    jwtUtil->initAndStart(config);
+    Json::Value data;
+    data["uid"] = 1;
+    auto token = jwtUtil->encode(data);
+
+    auto req = drogon::HttpRequest::newHttpRequest();
+    req->addHeader("Authorization", "bearer " + token);
+    auto [result, payload] = jwtUtil->decodeForRequest(req);
+    ASSERT_EQ(result, tl::jwt::Ok);
+    EXPECT_EQ((*payload)["uid"].asInt(), 1);
+
+    // not verified again, even if the secret is changed
+    jwtUtil->setSecret("another secret");
+    auto second = jwtUtil->decodeForRequest(req);
+    EXPECT_EQ(second.first, tl::jwt::Ok);
+    EXPECT_EQ(second.second.get(), payload.get());
+
+    auto other = drogon::HttpRequest::newHttpRequest();
+    EXPECT_EQ(jwtUtil->decodeForRequest(other).first, tl::jwt::InvalidToken);
+    other = drogon::HttpRequest::newHttpRequest();
+    other->addHeader("Authorization", "Bearer " + token);
+    EXPECT_EQ(jwtUtil->decodeForRequest(other).first,
+              tl::jwt::InvalidSignature);
+}
+
+/// The port of app(), which is listened by main().
+constexpr uint16_t testPort = 18848;
+
+/// Binds the token of the query, and rebinds the token of every message. The
+/// Result of binding is sent back, and "session" is answered with whether
+/// the connection is still bound. "foreign <token>" sets a context of the
+/// application before binding the token.
+class JwtUtilTestSocket : public drogon::WebSocketController<JwtUtilTestSocket>
+{
+  public:
+    void handleNewConnection(
+        const drogon::HttpRequestPtr& req,
+        const drogon::WebSocketConnectionPtr& conn) override
+    {
+        bind(conn, req->getParameter("token"));
+    }
+
+    void handleNewMessage(const drogon::WebSocketConnectionPtr& conn,
+                          std::string&& message,
+                          const drogon::WebSocketMessageType&) override
+    {
+        if (message == "session")
+        {
+            conn->send(tl::jwt::JwtUtil::sessionOf(conn) ? "bound"
+                                                         : "unbound");
+            return;
+        }
+        if (message.starts_with("foreign "))
+        {
+            conn->setContext(std::make_shared<int>(0));
+            try
+            {
+                bind(conn, message.substr(8));
+            }
+            catch (const std::logic_error&)
+            {
+                conn->send("refused");
+            }
+            return;
+        }
+        bind(conn, message);
+    }
+
+    void handleConnectionClosed(const drogon::WebSocketConnectionPtr&) override
+    {
+    }
+
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/jwt-util-test/ws");
+    WS_PATH_LIST_END
+
+    static inline std::shared_ptr<tl::jwt::JwtUtil> jwtUtil;
+
+  private:
+    static void bind(const drogon::WebSocketConnectionPtr& conn,
+                     const std::string& token)
+    {
+        auto result = jwtUtil->bindConnection(
+            conn, token, [](const drogon::WebSocketConnectionPtr& conn) {
+                conn->send(tl::jwt::JwtUtil::sessionOf(conn) ? "bound"
+                                                             : "expired");
+                conn->shutdown(drogon::CloseCode::kViolation, "Token expired");
+            });
+        conn->send(tl::jwt::toString(result));
+    }
+};
+
+/// A client of JwtUtilTestSocket, which keeps the received messages.
+class TestSocketClient
+{
+  public:
+    explicit TestSocketClient(const std::string& token)
+        : client_(drogon::WebSocketClient::newWebSocketClient("127.0.0.1",
+                                                              testPort))
+    {
+        // the handlers may be called after this is destroyed
+        auto state = state_;
+        client_->setMessageHandler(
+            [state](std::string&& message,
+                    const drogon::WebSocketClientPtr&,
+                    const drogon::WebSocketMessageType&) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->messages.push_back(std::move(message));
+                state->changed.notify_all();
+            });
+        client_->setConnectionClosedHandler(
+            [state](const drogon::WebSocketClientPtr&) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->closed = true;
+                state->changed.notify_all();
+            });
+
+        auto req = drogon::HttpRequest::newHttpRequest();
+        req->setPath("/jwt-util-test/ws");
+        req->setParameter("token", token);
+        std::promise<drogon::ReqResult> connected;
+        client_->connectToServer(
+            req,
+            [&connected](drogon::ReqResult result,
+                         const drogon::HttpResponsePtr&,
+                         const drogon::WebSocketClientPtr&) {
+                connected.set_value(result);
+            });
+        result_ = connected.get_future().get();
+    }
+
+    TestSocketClient(const TestSocketClient&) = delete;
+    TestSocketClient& operator=(const TestSocketClient&) = delete;
+
+    ~TestSocketClient()
+    {
+        client_->stop();
+    }
+
+    drogon::ReqResult result() const
+    {
+        return result_;
+    }
+
+    void send(const std::string& message)
+    {
+        client_->getConnection()->send(message);
+    }
+
+    /// The next message, or "" if nothing is received in time.
+    std::string next(std::chrono::seconds timeout = std::chrono::seconds(5))
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        if (!state_->changed.wait_for(lock, timeout, [this]() {
+                return !state_->messages.empty();
+            }))
+        {
+            return "";
+        }
+        auto message = std::move(state_->messages.front());
+        state_->messages.pop_front();
+        return message;
+    }
+
+    bool waitClosed(std::chrono::seconds timeout = std::chrono::seconds(5))
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        return state_->changed.wait_for(lock, timeout, [this]() {
+            return state_->closed;
+        });
+    }
+
+  private:
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::string> messages;
+        bool closed{false};
+    };
+
+    std::shared_ptr<State> state_{std::make_shared<State>()};
+    drogon::WebSocketClientPtr client_;
+    drogon::ReqResult result_;
+};
+
+TEST(TestWebSocket, ExpireAndRebind)
+{
+    // the short token is in its last second by the clock of the plugin, so
+    // the timers fire after one second, whenever the test runs
+    Json::Value config;
+    config["secret"] = "tanglong3bf";
+    JwtUtilTestSocket::jwtUtil = std::make_shared<tl::jwt::JwtUtil>();
+    JwtUtilTestSocket::jwtUtil->initAndStart(config);
+    JwtUtilTestSocket::jwtUtil->setClock(
+        std::make_shared<tl::jwt::ManualClock>(1700000000));
+    auto longToken = JwtUtilTestSocket::jwtUtil->encode({});
+    config["payload"]["exp"] = 1;
+    auto shortLived = std::make_unique<tl::jwt::JwtUtil>();
+    shortLived->initAndStart(config);
+    shortLived->setClock(std::make_shared<tl::jwt::ManualClock>(1699999999));
+    auto shortToken = shortLived->encode({});
+
+    // bound first, so its first timer would fire before the other one
+    TestSocketClient rebound(shortToken);
+    ASSERT_EQ(rebound.result(), drogon::ReqResult::Ok);
+    EXPECT_EQ(rebound.next(), "Ok");
+    // a rejected token keeps the previous one
+    rebound.send("invalid");
+    EXPECT_EQ(rebound.next(), "InvalidToken");
+    rebound.send(longToken);
+    EXPECT_EQ(rebound.next(), "Ok");
+
+    TestSocketClient expiring(shortToken);
+    ASSERT_EQ(expiring.result(), drogon::ReqResult::Ok);
+    EXPECT_EQ(expiring.next(), "Ok");
+    // the session is removed before onExpired, which closes the connection
+    EXPECT_EQ(expiring.next(), "expired");
+    EXPECT_TRUE(expiring.waitClosed());
+
+    // the first timer of the rebound connection was canceled
+    rebound.send("session");
+    EXPECT_EQ(rebound.next(), "bound");
+    EXPECT_FALSE(rebound.waitClosed(std::chrono::seconds(0)));
+
+    // the context of the application is not replaced
+    rebound.send("foreign " + longToken);
+    EXPECT_EQ(rebound.next(), "refused");
+    rebound.send("session");
+    EXPECT_EQ(rebound.next(), "unbound");
+
+    shortLived->shutdown();
+    JwtUtilTestSocket::jwtUtil->shutdown();
+}
+
+TEST(TestPolicy, Decode)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["payload"]["iss"] = "tanglong3bf";
+    config["payload"]["aud"] = "visitor";
+    Json::Value policy;
+    policy["required"].append("uid");
+    policy["equals"]["iss"] = "tanglong3bf";
+    policy["audience"].append("visitor");
+    policy["audience"].append("admin");
+    policy["contains"]["roles"] = "reader";
+    policy["range"]["level"]["min"] = 1;
+    policy["range"]["level"]["max"] = 10;
+    config["policy"] = policy;
+    jwtUtil->initAndStart(config);
+
+    Json::Value data;
+    data["uid"] = 1;
+    data["roles"].append("writer");
+    data["roles"].append("reader");
+    data["level"] = 3;
+    auto token = jwtUtil->encode(data);
+    EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->refresh(token).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->decodeCwt(jwtUtil->encodeCwt(data)).first,
+              tl::jwt::Ok);
+
+    auto expect = [&jwtUtil](const Json::Value& data, tl::jwt::Result result) {
+        auto token = jwtUtil->encode(data);
+        EXPECT_EQ(jwtUtil->decode(token).first, result);
+        std::string_view view = token;
+        EXPECT_EQ(jwtUtil->verifyBatch({&view, 1})[0], result);
+        EXPECT_EQ(jwtUtil->decodeCwt(jwtUtil->encodeCwt(data)).first, result);
+    };
+    auto missing = data;
+    missing.removeMember("uid");
+    expect(missing, tl::jwt::MissingClaim);
+    auto outOfRange = data;
+    outOfRange["level"] = 11;
+    expect(outOfRange, tl::jwt::InvalidClaim);
+    auto withoutRole = data;
+    withoutRole["roles"] = Json::arrayValue;
+    expect(withoutRole, tl::jwt::InvalidClaim);
+
+    config["payload"]["aud"] = "guest";
+    jwtUtil->initAndStart(config);
+    expect(data, tl::jwt::InvalidAudience);
+    jwtUtil->shutdown();
+}
+
+TEST(TestPolicy, InvalidConfig)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value policy;
+    policy["equal"]["iss"] = "tanglong3bf";
+    EXPECT_THROW(jwtUtil->setPolicy(policy), std::invalid_argument);
+    policy = Json::Value();
+    policy["range"]["level"]["min"] = "1";
+    EXPECT_THROW(jwtUtil->setPolicy(policy), std::invalid_argument);
+    policy = Json::Value();
+    policy["range"]["level"] = 1;
+    EXPECT_THROW(jwtUtil->setPolicy(policy), std::invalid_argument);
+}
+
+TEST(TestEncodeTo, Span)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    Json::Value data;
+    data["user_id"] = 1;
+    auto jwt = jwtUtil->encode(data);
+
+    char small[16];
+    ASSERT_EQ(jwtUtil->encodeTo(data, small), jwt.size());
+
+    std::vector<char> buf(jwt.size() + 8, 'x');
+    auto len = jwtUtil->encodeTo(data, buf);
+    ASSERT_EQ(len, jwt.size());
+    EXPECT_EQ(buf[len], 'x');
+    auto result = jwtUtil->decode(std::string(buf.data(), len));
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ((*result.second)["user_id"].asInt(), 1);
+    jwtUtil->shutdown();
+}
+
+TEST(TestEncodeTo, MsgBuffer)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["alg"] = "HS512";
+    jwtUtil->initAndStart(config);
+    trantor::MsgBuffer buf;
+    buf.append("Bearer ", 7);
+    auto len = jwtUtil->encodeTo(Json::Value(), buf);
+    ASSERT_EQ(buf.readableBytes(), len + 7);
+    auto result =
+        jwtUtil->decode(std::string(buf.peek() + 7, buf.readableBytes() - 7));
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    jwtUtil->shutdown();
+}
+
+TEST(TestRefresh, Ok)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["payload"]["iss"] = "tanglong3bf";
+    config["payload"]["jti"] = true;
+    jwtUtil->initAndStart(config);
+    Json::Value data;
+    data["user_id"] = 1;
+    data["roles"][0] = "admin";
+    data["profile"]["name"] = "tang \"long\"";
+    auto jwt = jwtUtil->encode(data);
+
+    auto refreshed = jwtUtil->refresh(jwt);
+    ASSERT_EQ(refreshed.first, tl::jwt::Ok)
+        << "result.first: " << toString(refreshed.first);
+    ASSERT_NE(refreshed.second, jwt);
+    auto oldPayload = jwtUtil->decode(jwt).second;
+    auto newPayload = jwtUtil->decode(refreshed.second).second;
+    ASSERT_NE(newPayload, nullptr);
+    EXPECT_NE((*oldPayload)["jti"], (*newPayload)["jti"]);
+    oldPayload->removeMember("jti");
+    newPayload->removeMember("jti");
+    EXPECT_EQ(*oldPayload, *newPayload);
+    jwtUtil->shutdown();
+}
+
+TEST(TestRefresh, InvalidSignature)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    auto jwt = jwtUtil->encode(Json::Value());
+    jwt.back() = jwt.back() == 'A' ? 'B' : 'A';
+    auto refreshed = jwtUtil->refresh(jwt);
+    ASSERT_EQ(refreshed.first, tl::jwt::InvalidSignature)
+        << "result.first: " << toString(refreshed.first);
+    ASSERT_TRUE(refreshed.second.empty());
+    jwtUtil->shutdown();
+}
+
+TEST(TestZip, LargePayload)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["zip"] = true;
+    config["zip_threshold"] = 256;
+    jwtUtil->initAndStart(config);
+    Json::Value data;
+    for (int i = 0; i < 1000; ++i)
+    {
+        data["permissions"].append("resource:" + std::to_string(i) + ":read");
+    }
+    auto jwt = jwtUtil->encode(data);
+    ASSERT_EQ(jwt.substr(0, jwt.find('.')),
+              tl::jwt::base64ZipHeaderList.at(tl::jwt::HS256));
+    ASSERT_LT(jwt.size(), 8192);
+    auto result = jwtUtil->decode(jwt);
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ((*result.second)["permissions"], data["permissions"]);
+
+    auto refreshed = jwtUtil->refresh(jwt);
+    ASSERT_EQ(refreshed.first, tl::jwt::Ok)
+        << "result.first: " << toString(refreshed.first);
+    result = jwtUtil->decode(refreshed.second);
+    ASSERT_EQ(result.first, tl::jwt::Ok);
+    EXPECT_EQ((*result.second)["permissions"], data["permissions"]);
+    jwtUtil->shutdown();
+}
+
+TEST(TestZip, InflatedTooLarge)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["zip"] = true;
+    jwtUtil->initAndStart(config);
+    // a few KiB on the wire, but more than 1 MiB once inflated
+    Json::Value data;
+    data["padding"] = std::string(size_t(1) << 20, 'a');
+    auto jwt = jwtUtil->encode(data);
+    ASSERT_EQ(jwt.substr(0, jwt.find('.')),
+              tl::jwt::base64ZipHeaderList.at(tl::jwt::HS256));
+    ASSERT_LT(jwt.size(), 8192);
+    auto result = jwtUtil->decode(jwt);
+    EXPECT_EQ(result.first, tl::jwt::InvalidPayload)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ(result.second, nullptr);
+    EXPECT_EQ(jwtUtil->refresh(jwt).first, tl::jwt::InvalidPayload);
+
+    // just below the limit, it is still accepted
+    data["padding"] = std::string((size_t(1) << 20) - 4096, 'a');
+    jwt = jwtUtil->encode(data);
+    result = jwtUtil->decode(jwt);
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ((*result.second)["padding"], data["padding"]);
+    jwtUtil->shutdown();
+}
+
+TEST(TestZip, SmallPayload)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["zip"] = true;
+    jwtUtil->initAndStart(config);
+    Json::Value data;
+    data["user_id"] = 1;
+    auto jwt = jwtUtil->encode(data);
+    ASSERT_EQ(jwt.substr(0, jwt.find('.')),
+              tl::jwt::base64HeaderList.at(tl::jwt::HS256));
+    ASSERT_EQ(jwtUtil->decode(jwt).first, tl::jwt::Ok);
+    jwtUtil->shutdown();
+}
+
+TEST(TestCwt, EncodeAndDecode)
+{
+    for (auto alg : {"HS256", "HS384", "HS512"})
+    {
+        auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+        jwtUtil->setSecret("secret");
+        Json::Value config;
+        config["alg"] = alg;
+        config["payload"]["iss"] = "tanglong3bf";
+        config["payload"]["jti"] = true;
+        jwtUtil->initAndStart(config);
+        Json::Value data;
+        data["user_id"] = -1;
+        data["big"] = Json::UInt64(1) << 63;
+        data["ratio"] = 0.5;
+        data["admin"] = true;
+        data["none"] = Json::Value();
+        data["roles"][0] = "reader";
+        data["profile"]["name"] = "tanglong3bf";
+        auto cwt = jwtUtil->encodeCwt(data);
+        // tag 61 and tag 17
+        ASSERT_EQ(cwt.substr(0, 3), "\xd8\x3d\xd1");
+        ASSERT_LT(cwt.size(), jwtUtil->encode(data).size());
+
+        auto result = jwtUtil->decodeCwt(cwt);
+        ASSERT_EQ(result.first, tl::jwt::Ok)
+            << alg << " result.first: " << toString(result.first);
+        auto payload = *result.second;
+        EXPECT_EQ(payload["iss"].asString(), "tanglong3bf");
+        EXPECT_TRUE(payload["jti"].isString());
+        payload.removeMember("iss");
+        payload.removeMember("jti");
+        EXPECT_EQ(payload, data) << payload.toStyledString();
+        jwtUtil->shutdown();
+    }
+}
+
+TEST(TestCwt, KeySet)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->initAndStart({});
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+    ]})");
+    Json::Value data;
+    data["user_id"] = 1;
+    auto oldToken = jwtUtil->encodeCwt(data);
+    // {4: h'6f6c64'} follows the protected header
+    const char kidHeader[] = "\x43\xa1\x01\x05\xa1\x04\x43"
+                             "old";
+    EXPECT_NE(oldToken.find(kidHeader), std::string::npos);
+
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"},
+        {"kty": "oct", "kid": "old", "alg": "HS256", "k": "b2xk"}
+    ]})");
+    auto newToken = jwtUtil->encodeCwt(data);
+    auto result = jwtUtil->decodeCwt(oldToken);
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    EXPECT_EQ((*result.second)["user_id"].asInt(), 1);
+    EXPECT_EQ(jwtUtil->decodeCwt(newToken).first, tl::jwt::Ok);
+
+    jwtUtil->setKeys(R"({"keys": [
+        {"kty": "oct", "kid": "new", "alg": "HS512", "k": "bmV3"}
+    ]})");
+    EXPECT_EQ(jwtUtil->decodeCwt(oldToken).first, tl::jwt::InvalidSignature);
+    EXPECT_EQ(jwtUtil->decodeCwt(newToken).first, tl::jwt::Ok);
+
+    // back to the secret, the kid is ignored
+    jwtUtil->setKeys("");
+    EXPECT_EQ(jwtUtil->decodeCwt(newToken).first, tl::jwt::InvalidAlgorithm);
+    jwtUtil->shutdown();
+}
+
+TEST(TestCwt, InvalidToken)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    auto cwt = jwtUtil->encodeCwt(Json::Value());
+    EXPECT_EQ(jwtUtil->decodeCwt(cwt.substr(0, cwt.size() - 1)).first,
+              tl::jwt::InvalidToken);
+    cwt.back() ^= 1;
+    EXPECT_EQ(jwtUtil->decodeCwt(cwt).first, tl::jwt::InvalidSignature);
+    // without the tags
+    cwt.back() ^= 1;
+    EXPECT_EQ(jwtUtil->decodeCwt(cwt.substr(3)).first, tl::jwt::Ok);
+
+    auto other = std::make_unique<tl::jwt::JwtUtil>();
+    other->setSecret("secret");
+    Json::Value config;
+    config["alg"] = "HS512";
+    other->initAndStart(config);
+    EXPECT_EQ(other->decodeCwt(cwt).first, tl::jwt::InvalidAlgorithm);
+    jwtUtil->shutdown();
+    other->shutdown();
+}
+
+#ifdef TL_JWT_USE_OPENSSL
+TEST(TestCryptoBackend, SameMac)
+{
+    for (size_t n : {0, 1, 31, 64, 65, 127, 128, 129, 1000})
+    {
+        std::string secret(n, 'k');
+        std::string message(n * 3 + 8, 'm');
+        unsigned char builtin[64], openssl[64];
+
+        tl::jwt::Hmac<tl::jwt::sha2::Sha256>(secret).sign(message, builtin);
+        tl::jwt::OpenSslHmac("SHA256", 32, secret).sign(message, openssl);
+        EXPECT_EQ(std::memcmp(builtin, openssl, 32), 0) << n;
+
+        tl::jwt::Hmac<tl::jwt::sha2::Sha384>(secret).sign(message, builtin);
+        tl::jwt::OpenSslHmac("SHA384", 48, secret).sign(message, openssl);
+        EXPECT_EQ(std::memcmp(builtin, openssl, 48), 0) << n;
+
+        tl::jwt::Hmac<tl::jwt::sha2::Sha512> hmac(secret);
+        auto ctx = hmac.begin();
+        ctx.update(message.data(), 7);
+        ctx.update(message.data() + 7, message.size() - 7);
+        hmac.finish(ctx, builtin);
+        tl::jwt::OpenSslHmac opensslHmac("SHA512", 64, secret);
+        auto opensslCtx = opensslHmac.begin();
+        opensslCtx.update(message.data(), 7);
+        opensslCtx.update(message.data() + 7, message.size() - 7);
+        opensslHmac.finish(opensslCtx, openssl);
+        EXPECT_EQ(std::memcmp(builtin, openssl, 64), 0) << n;
+    }
+}
+
+TEST(TestCryptoBackend, EncodeAndDecode)
+{
+    for (auto alg : {"HS256", "HS384", "HS512"})
+    {
+        auto builtin = std::make_unique<tl::jwt::JwtUtil>();
+        auto openssl = std::make_unique<tl::jwt::JwtUtil>();
+        Json::Value config;
+        config["secret"] = "secret";
+        config["alg"] = alg;
+        builtin->initAndStart(config);
+        config["crypto"] = "openssl";
+        openssl->initAndStart(config);
+        Json::Value data;
+        data["user_id"] = 1;
+        EXPECT_EQ(openssl->decode(builtin->encode(data)).first, tl::jwt::Ok);
+        EXPECT_EQ(builtin->decode(openssl->encode(data)).first, tl::jwt::Ok);
+        EXPECT_EQ(builtin->decodeCwt(openssl->encodeCwt(data)).first,
+                  tl::jwt::Ok);
+        builtin->shutdown();
+        openssl->shutdown();
+    }
+}
+
+std::string generatePem(const char* type, bool isPrivate)
+{
+    static EVP_PKEY* ed25519 = EVP_PKEY_Q_keygen(nullptr, nullptr, "ED25519");
+    static EVP_PKEY* p256 =
+        EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256");
+    auto* key = std::string_view(type) == "EdDSA" ? ed25519 : p256;
+    auto* bio = BIO_new(BIO_s_mem());
+    if (isPrivate)
+    {
+        PEM_write_bio_PrivateKey(bio, key, nullptr, nullptr, 0, nullptr, nullptr);
+    }
+    else
+    {
+        PEM_write_bio_PUBKEY(bio, key);
+    }
+    char* data;
+    auto len = BIO_get_mem_data(bio, &data);
+    std::string pem(data, len);
+    BIO_free(bio);
+    return pem;
+}
+
+TEST(TestAsymmetric, EncodeAndDecode)
+{
+    for (auto alg : {"EdDSA", "ES256"})
+    {
+        auto signer = std::make_unique<tl::jwt::JwtUtil>();
+        auto verifier = std::make_unique<tl::jwt::JwtUtil>();
+        Json::Value config;
+        config["alg"] = alg;
+        signer->initAndStart(config);
+        verifier->initAndStart(config);
+        signer->setPemKeys(generatePem(alg, true));
+        verifier->setPemKeys("", generatePem(alg, false));
+
+        Json::Value data;
+        data["user_id"] = 1;
+        auto token = signer->encode(data);
+        auto result = verifier->decode(token);
+        ASSERT_EQ(result.first, tl::jwt::Ok) << alg;
+        EXPECT_EQ((*result.second)["user_id"].asInt(), 1);
+        EXPECT_EQ(signer->decode(token).first, tl::jwt::Ok);
+        // a verifier can not sign
+        EXPECT_THROW(verifier->encode(data), std::runtime_error);
+
+        auto tampered = token;
+        tampered[tampered.size() - 10] ^= 1;
+        EXPECT_EQ(verifier->decode(tampered).first,
+                  tl::jwt::InvalidSignature);
+        EXPECT_EQ(verifier->decode(token.substr(0, token.size() - 4)).first,
+                  tl::jwt::InvalidSignature);
+        signer->shutdown();
+        verifier->shutdown();
+    }
+}
+
+TEST(TestAsymmetric, InvalidKey)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["alg"] = "ES256";
+    jwtUtil->initAndStart(config);
+    EXPECT_THROW(jwtUtil->setPemKeys("", "not a key"), std::invalid_argument);
+    EXPECT_THROW(jwtUtil->setPemKeys(generatePem("EdDSA", true)),
+                 std::invalid_argument);
+    jwtUtil->shutdown();
+}
+
+TEST(TestAsymmetric, VerifyBatch)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    Json::Value config;
+    config["alg"] = "EdDSA";
+    config["payload"]["nbf"] = 100;
+    jwtUtil->initAndStart(config);
+    jwtUtil->setPemKeys(generatePem("EdDSA", true));
+
+    auto notBefore = jwtUtil->encode({});
+    config["payload"]["nbf"] = 0;
+    jwtUtil->initAndStart(config);
+    jwtUtil->setPemKeys(generatePem("EdDSA", true));
+    auto ok = jwtUtil->encode({});
+    auto tampered = ok;
+    tampered[tampered.size() - 10] ^= 1;
+
+    std::vector<std::string_view> tokens{ok, notBefore, tampered, "a.b"};
+    auto results = jwtUtil->verifyBatch(tokens);
+    ASSERT_EQ(results.size(), 4);
+    EXPECT_EQ(results[0], tl::jwt::Ok);
+    EXPECT_EQ(results[1], tl::jwt::InvalidNotBefore);
+    EXPECT_EQ(results[2], tl::jwt::InvalidSignature);
+    EXPECT_EQ(results[3], tl::jwt::InvalidToken);
+    jwtUtil->shutdown();
+}
+#endif
+
+struct UserClaims
+{
+    int64_t uid{0};
+    std::string name;
+    bool admin{false};
+    std::optional<std::vector<std::string>> roles;
+
+    static constexpr auto jwtFields =
+        std::make_tuple(tl::jwt::field("uid", &UserClaims::uid),
+                        tl::jwt::field("name", &UserClaims::name),
+                        tl::jwt::field("admin", &UserClaims::admin),
+                        tl::jwt::field("roles", &UserClaims::roles));
+};
+
+TEST(TestTypedClaims, EncodeAndDecode)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["payload"]["iss"] = "tanglong3bf";
+    config["payload"]["jti"] = true;
+    jwtUtil->initAndStart(config);
+    UserClaims user;
+    user.uid = 1LL << 40;
+    user.name = "tang\"long\"\n3bf";
+    user.admin = true;
+    user.roles = std::vector<std::string>{"reader", "writer"};
+    auto jwt = jwtUtil->encode(user);
+    auto result = jwtUtil->decode<UserClaims>(jwt);
+    ASSERT_EQ(result.first, tl::jwt::Ok)
+        << "result.first: " << toString(result.first);
+    ASSERT_TRUE(result.second.has_value());
+    EXPECT_EQ(result.second->uid, user.uid);
+    EXPECT_EQ(result.second->name, user.name);
+    EXPECT_TRUE(result.second->admin);
+    EXPECT_EQ(result.second->roles, user.roles);
+
+    // the same token can be decoded into a Json::Value
+    auto value = jwtUtil->decode(jwt);
+    ASSERT_EQ(value.first, tl::jwt::Ok);
+    EXPECT_EQ((*value.second)["uid"].asInt64(), user.uid);
+    EXPECT_EQ((*value.second)["name"].asString(), user.name);
+    EXPECT_EQ((*value.second)["iss"].asString(), "tanglong3bf");
+    EXPECT_TRUE((*value.second)["jti"].isString());
+    jwtUtil->shutdown();
+}
+
+TEST(TestTypedClaims, DecodeFromJsonValue)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    Json::Value data;
+    data["uid"] = 42;
+    data["name"] = "tanglong3bf";
+    data["unknown"]["nested"][0] = 1.5;
+    auto result = jwtUtil->decode<UserClaims>(jwtUtil->encode(data));
+    ASSERT_EQ(result.first, tl::jwt::Ok);
+    EXPECT_EQ(result.second->uid, 42);
+    EXPECT_EQ(result.second->name, "tanglong3bf");
+    EXPECT_FALSE(result.second->admin);
+    EXPECT_FALSE(result.second->roles.has_value());
+    jwtUtil->shutdown();
+}
+
+TEST(TestTypedClaims, InvalidPayload)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    Json::Value data;
+    data["uid"] = "not a number";
+    auto result = jwtUtil->decode<UserClaims>(jwtUtil->encode(data));
+    ASSERT_EQ(result.first, tl::jwt::InvalidPayload)
+        << "result.first: " << toString(result.first);
+    jwtUtil->shutdown();
+}
+
+TEST(TestTypedClaims, InvalidNbf)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    Json::Value config;
+    config["payload"]["nbf"] = 10;
+    jwtUtil->initAndStart(config);
+    auto result = jwtUtil->decode<UserClaims>(jwtUtil->encode(UserClaims{}));
+    ASSERT_EQ(result.first, tl::jwt::InvalidNotBefore)
+        << "result.first: " << toString(result.first);
+    jwtUtil->shutdown();
+}
+
+TEST(TestTimeClaims, NonInteger)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+    auto clock = std::make_shared<tl::jwt::ManualClock>(1699999999);
+    jwtUtil->setClock(clock);
+
+    // the "nbf" of the payloads are kept
+    Json::Value data;
+    data["nbf"] = 1700000000.5;
+    auto fractional = jwtUtil->encode(data);
+    data["nbf"] = "1700000000";
+    auto string = jwtUtil->encode(data);
+    data["nbf"] = Json::Value(Json::arrayValue);
+    auto array = jwtUtil->encode(data);
+
+    // the fraction is truncated, instead of ignoring the claim
+    EXPECT_EQ(jwtUtil->decode(fractional).first, tl::jwt::InvalidNotBefore);
+    EXPECT_EQ(jwtUtil->decode<UserClaims>(fractional).first,
+              tl::jwt::InvalidNotBefore);
+    EXPECT_EQ(jwtUtil->refresh(fractional).first, tl::jwt::InvalidNotBefore);
+    clock->advance(1);
+    EXPECT_EQ(jwtUtil->decode(fractional).first, tl::jwt::Ok);
+    EXPECT_EQ(jwtUtil->decode<UserClaims>(fractional).first, tl::jwt::Ok);
+
+    // the claims which are not numbers are refused
+    for (const auto& token : {string, array})
+    {
+        EXPECT_EQ(jwtUtil->decode(token).first, tl::jwt::InvalidPayload);
+        EXPECT_EQ(jwtUtil->decode<UserClaims>(token).first,
+                  tl::jwt::InvalidPayload);
+        EXPECT_EQ(jwtUtil->refresh(token).first, tl::jwt::InvalidPayload);
+        std::string_view view = token;
+        EXPECT_EQ(jwtUtil->verifyBatch({&view, 1})[0],
+                  tl::jwt::InvalidPayload);
+    }
+    jwtUtil->shutdown();
+}
+
+TEST(TestTimeClaims, InvalidNumber)
+{
+    auto jwtUtil = std::make_unique<tl::jwt::JwtUtil>();
+    jwtUtil->setSecret("secret");
+    jwtUtil->initAndStart({});
+
+    // signed by another implementation, the payloads are {"exp":nan},
+    // {"exp":inf}, {"exp":01} and {"exp":1.}, which are not JSON
+    for (std::string_view token :
+         {"eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJleHAiOm5hbn0."
+          "QLqDpNULAccbeqBEHK6sADp99VT4OL7IAt6M1eFTYKk",
+          "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJleHAiOmluZn0."
+          "TnE5gl-B_LrvYCsL4xLPeXRGzE5PX_eN7KpypqjJnv0",
+          "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJleHAiOjAxfQ."
+          "d_n6MZvZWv9KfmFTAlOefn6Q6phYc6RLy-oI70ZVrxA",
+          "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJleHAiOjEufQ."
+          "K2KjlAFK8XfrewLVKWPLxvpXSR2iB8vOx-yLIV1KpOI"})
+    {
+        // JsonCpp reads 01 and 1. as 1, which has expired
+        EXPECT_NE(jwtUtil->decode(std::string(token)).first, tl::jwt::Ok)
+            << token;
+        EXPECT_EQ(jwtUtil->decode<UserClaims>(token).first,
+                  tl::jwt::InvalidPayload)
+            << token;
+        EXPECT_EQ(jwtUtil->refresh(token).first, tl::jwt::InvalidPayload)
+            << token;
+        EXPECT_EQ(jwtUtil->verifyBatch({&token, 1})[0],
+                  tl::jwt::InvalidPayload)
+            << token;
+    }
+    jwtUtil->shutdown();
+}